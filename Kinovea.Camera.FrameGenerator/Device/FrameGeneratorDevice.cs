@@ -48,6 +48,7 @@ namespace Kinovea.Camera.FrameGenerator
         private Stopwatch stopwatch = new Stopwatch();
         private double frameIntervalMilliseconds;
         private double dueTime;
+        private volatile FramePipeline pipeline;
 
         private NativeMethods.TimerCallback timerCallback;
         private uint timerId;
@@ -84,6 +85,19 @@ namespace Kinovea.Camera.FrameGenerator
             }
         }
 
+        /// <summary>
+        /// Generate the frames directly into the pipeline slots instead of raising them for copy.
+        /// </summary>
+        public void SetPipeline(FramePipeline pipeline)
+        {
+            this.pipeline = pipeline;
+        }
+
+        public void ClearPipeline()
+        {
+            this.pipeline = null;
+        }
+
         /// <summary>
         /// Helper method to create a full bitmap from the current frame buffer.
         /// Used in the context of thumbnail creation.
@@ -163,17 +177,42 @@ namespace Kinovea.Camera.FrameGenerator
             if (stopwatch.Elapsed.TotalMilliseconds < dueTime)
                 return;
 
-            currentFrameBuffer = generator.Generate();
             generatedFrames++;
-
             dueTime = (generatedFrames + 1) * frameIntervalMilliseconds;
 
+            FramePipeline pipeline = this.pipeline;
+            if (pipeline != null)
+            {
+                ProduceInPlace(pipeline);
+                return;
+            }
+
+            currentFrameBuffer = generator.Generate();
+
             int length = currentFrameBuffer == null ? 0 : currentFrameBuffer.Length;
 
             if (FrameProduced != null)
                 FrameProduced(this, new FrameProducedEventArgs(currentFrameBuffer, length));
         }
 
+        private void ProduceInPlace(FramePipeline pipeline)
+        {
+            Frame entry;
+            int length = 0;
+
+            if (pipeline.TryClaimSlot(out entry))
+            {
+                if (generator.Generate(entry.Buffer))
+                    length = imageDescriptor.BufferSize;
+
+                pipeline.CommitSlot(entry, length);
+                currentFrameBuffer = entry.Buffer;
+            }
+
+            if (FrameProduced != null)
+                FrameProduced(this, new FrameProducedEventArgs(currentFrameBuffer, length, true));
+        }
+
         #endregion
     }
 }
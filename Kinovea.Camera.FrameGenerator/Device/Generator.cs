@@ -39,11 +39,24 @@ namespace Kinovea.Camera.FrameGenerator
                 return null;
 
             CopyBackground();
-            CopyTimestamp();
+            CopyTimestamp(frameBuffer);
 
             return frameBuffer;
         }
 
+        /// <summary>
+        /// Generate the image directly into the passed buffer, typically a ring buffer slot.
+        /// Only the timestamp area is written, the rest of the buffer is expected to already hold the background.
+        /// </summary>
+        public bool Generate(byte[] buffer)
+        {
+            if (!allocated || buffer.Length < frameBuffer.Length)
+                return false;
+
+            CopyTimestamp(buffer);
+            return true;
+        }
+
         private void Initialize()
         {
             int bufferSize = ImageFormatHelper.ComputeBufferSize(configuration.Width, configuration.Height, configuration.ImageFormat);
@@ -77,7 +90,7 @@ namespace Kinovea.Camera.FrameGenerator
 
         }
 
-        private void CopyTimestamp()
+        private void CopyTimestamp(byte[] buffer)
         {
             // Reset timestamp bitmap
             string text = string.Format(@"{0:yyyy-MM-dd HH\:mm\:ss\.fff}", DateTime.Now);
@@ -89,7 +102,7 @@ namespace Kinovea.Camera.FrameGenerator
             }
 
             // Copy bitmap content over framebuffer.
-            BitmapHelper.CopyBitmapRectangle(bmpTimestamp, timestampLocation, frameBuffer, stride);
+            BitmapHelper.CopyBitmapRectangle(bmpTimestamp, timestampLocation, buffer, stride);
         }
     }
 }
@@ -29,7 +29,7 @@ using Kinovea.Video;
 
 namespace Kinovea.Camera.FrameGenerator
 {
-    public class FrameGrabber : ICaptureSource
+    public class FrameGrabber : ICaptureSource, IFrameSlotProducer
     {
         public event EventHandler<FrameProducedEventArgs> FrameProduced;
         public event EventHandler GrabbingStatusChanged;
@@ -129,6 +129,18 @@ namespace Kinovea.Camera.FrameGenerator
         public void Close()
         {
         }
+
+        public void SetPipeline(FramePipeline pipeline)
+        {
+            if (device != null)
+                device.SetPipeline(pipeline);
+        }
+
+        public void ClearPipeline()
+        {
+            if (device != null)
+                device.ClearPipeline();
+        }
         #endregion
 
         #region Private methods
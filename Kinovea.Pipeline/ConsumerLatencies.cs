@@ -0,0 +1,56 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Text;
+using System.Diagnostics;
+using Kinovea.Services;
+
+namespace Kinovea.Pipeline
+{
+    /// <summary>
+    /// Latency histograms for one consumer.
+    /// Wait: from the commit of the frame by the producer to its pickup by the consumer.
+    /// Process: from the pickup to the completion of the processing.
+    /// 
+    /// Recording is done by the consumer thread. 
+    /// Reset can be asked from any thread and is executed by the consumer thread on the next record.
+    /// </summary>
+    public class ConsumerLatencies
+    {
+        public LatencyHistogram Wait
+        {
+            get { return wait; }
+        }
+
+        public LatencyHistogram Process
+        {
+            get { return process; }
+        }
+
+        private LatencyHistogram wait = new LatencyHistogram();
+        private LatencyHistogram process = new LatencyHistogram();
+        private volatile bool resetAsked;
+
+        public void Record(Frame entry, long pickup, long completion)
+        {
+            //---------------------------
+            // Runs in a consumer thread.
+            //---------------------------
+
+            if (resetAsked)
+            {
+                wait.Reset();
+                process.Reset();
+                resetAsked = false;
+            }
+
+            wait.RecordTicks(pickup - entry.CommittedTimestamp);
+            process.RecordTicks(completion - pickup);
+        }
+
+        public void Reset()
+        {
+            resetAsked = true;
+        }
+    }
+}
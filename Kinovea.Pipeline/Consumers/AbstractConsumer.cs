@@ -3,7 +3,9 @@ using System.Collections.Generic;
 using System.Linq;
 using System.Text;
 using System.Threading;
+using System.Diagnostics;
 using Kinovea.Pipeline.MemoryLayout;
+using Kinovea.Pipeline.WaitStrategies;
 using Kinovea.Services;
 
 namespace Kinovea.Pipeline.Consumers
@@ -29,10 +31,25 @@ namespace Kinovea.Pipeline.Consumers
             get { return consumerPosition.Data; }
         }
 
+        public ConsumerLatencies Latencies
+        {
+            get { return latencies; }
+        }
+
         public virtual BenchmarkCounterBandwidth BenchmarkCounter
         {
             get { return null; }
         }
+
+        /// <summary>
+        /// How the consumer thread waits for the producer when it has caught up.
+        /// Must be set before the consumer is activated.
+        /// </summary>
+        public IWaitStrategy WaitStrategy
+        {
+            get { return waitStrategy; }
+            set { waitStrategy = value; }
+        }
         
         // Synchronization
         private CacheLineStorageBool started = new CacheLineStorageBool(false); 
@@ -41,7 +58,10 @@ namespace Kinovea.Pipeline.Consumers
         private CacheLineStorageBool active = new CacheLineStorageBool(false);
         private CacheLineStorageBool deactivateAsked = new CacheLineStorageBool(false);
         private CacheLineStorageLong consumerPosition = new CacheLineStorageLong(-1); 
+        private ConsumerLatencies latencies = new ConsumerLatencies();
         
+        private IWaitStrategy waitStrategy = new SpinThenYieldWaitStrategy();
+
         // Frame memory storage
         private RingBuffer buffer;
         protected int frameLength;
@@ -122,12 +142,14 @@ namespace Kinovea.Pipeline.Consumers
             while(!deactivateAsked.Data)
             {
                 // Wait until at least the next frame is available, but if more than one is available consume everything in batch.
-                long readable = buffer.WaitFor(next);
+                long readable = buffer.WaitFor(next, waitStrategy);
 
                 while (next <= readable)
                 {
                     Frame entry = buffer.GetEntry(next);
+                    long pickup = Stopwatch.GetTimestamp();
                     ProcessEntry(next, entry);
+                    latencies.Record(entry, pickup, Stopwatch.GetTimestamp());
                     next++;
                 }
 
@@ -29,10 +29,23 @@ namespace Kinovea.Pipeline
     {
         public readonly byte[] Buffer;
         public readonly int PayloadLength;
+
+        /// <summary>
+        /// The frame was written in place in a ring buffer slot and already committed (or dropped).
+        /// The pipeline must not copy it again.
+        /// </summary>
+        public readonly bool InPlace;
+
         public FrameProducedEventArgs(byte[] buffer, int payloadLength)
+            : this(buffer, payloadLength, false)
+        {
+        }
+
+        public FrameProducedEventArgs(byte[] buffer, int payloadLength, bool inPlace)
         {
             this.Buffer = buffer;
             this.PayloadLength = payloadLength;
+            this.InPlace = inPlace;
         }
     }
 }
\ No newline at end of file
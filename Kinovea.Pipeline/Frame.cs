@@ -2,21 +2,55 @@
 using System.Collections.Generic;
 using System.Linq;
 using System.Text;
+using System.Runtime.InteropServices;
 
 namespace Kinovea.Pipeline
 {
     /// <summary>
     /// Simple byte buffer. Format agnostic.
     /// The whole buffer might not be filled with payload.
+    /// 
+    /// The buffer is pinned for the lifetime of the frame so producers can have native code (camera SDK, decoder)
+    /// write directly into it through the Pointer property.
     /// </summary>
     public class Frame
     {
         public byte[] Buffer { get; private set; }
         public int PayloadLength { get; set; }
 
+        /// <summary>
+        /// Stopwatch timestamp at which the producer received the frame from the camera.
+        /// </summary>
+        public long ProducedTimestamp { get; set; }
+
+        /// <summary>
+        /// Stopwatch timestamp at which the frame was made available to the consumers.
+        /// </summary>
+        public long CommittedTimestamp { get; set; }
+
+        /// <summary>
+        /// Address of the first byte of the buffer. Valid until Release is called.
+        /// </summary>
+        public IntPtr Pointer
+        {
+            get { return handle.IsAllocated ? handle.AddrOfPinnedObject() : IntPtr.Zero; }
+        }
+
+        private GCHandle handle;
+
         public Frame(int bufferSize)
         {
             this.Buffer = new byte[bufferSize];
+            this.handle = GCHandle.Alloc(Buffer, GCHandleType.Pinned);
+        }
+
+        /// <summary>
+        /// Unpin the buffer.
+        /// </summary>
+        public void Release()
+        {
+            if (handle.IsAllocated)
+                handle.Free();
         }
     }
 }
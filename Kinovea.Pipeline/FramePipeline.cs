@@ -4,6 +4,7 @@ using System.Linq;
 using System.Text;
 using Kinovea.Services;
 using System.Threading;
+using System.Diagnostics;
 using Kinovea.Pipeline.MemoryLayout;
 
 namespace Kinovea.Pipeline
@@ -56,6 +57,13 @@ namespace Kinovea.Pipeline
         //private BenchmarkCounterIntervals commitbeat = new BenchmarkCounterIntervals();
         private FrequencyCounter frequencyCounter = new FrequencyCounter(24, 48, true);
 
+        // Latency histograms of the producer side, written by the producer thread.
+        // Consumers have their own histograms for the consumer side.
+        private LatencyHistogram produceInterval = new LatencyHistogram();
+        private LatencyHistogram produceToCommit = new LatencyHistogram();
+        private long lastProduced;
+        private volatile bool resetLatenciesAsked;
+
         // Note: we lock drops on write as it's written from UI thread and producer thread.
         // The freshness of the value is not paramount so we do not lock on read to avoid slowing down the producer thread.
         private int drops;
@@ -90,6 +98,48 @@ namespace Kinovea.Pipeline
                 drops = 0;
         }
 
+        /// <summary>
+        /// Clear the latency histograms of the producer and all consumers.
+        /// The histograms are actually cleared by their writer thread on the next frame.
+        /// </summary>
+        public void ResetLatencies()
+        {
+            resetLatenciesAsked = true;
+
+            foreach (IFrameConsumer consumer in consumers)
+                consumer.Latencies.Reset();
+        }
+
+        /// <summary>
+        /// Returns the latency histograms for each stage of the pipeline:
+        /// interval between frames received from the camera, time to write the frame in the ring buffer, 
+        /// and for each consumer the wait before pickup and the processing time.
+        /// Consumers are named after their type and their index in the pipeline, see GetConsumerName.
+        /// </summary>
+        public Dictionary<string, LatencyHistogram> GetLatencyHistograms()
+        {
+            Dictionary<string, LatencyHistogram> histograms = new Dictionary<string, LatencyHistogram>();
+            histograms.Add("Camera interval", produceInterval);
+            histograms.Add("Produce to commit", produceToCommit);
+
+            for (int i = 0; i < consumers.Count; i++)
+            {
+                string name = GetConsumerName(i);
+                histograms.Add(name + " wait", consumers[i].Latencies.Wait);
+                histograms.Add(name + " process", consumers[i].Latencies.Process);
+            }
+
+            return histograms;
+        }
+
+        /// <summary>
+        /// Returns a name identifying the consumer, unique within the pipeline even when several consumers share the same type.
+        /// </summary>
+        public string GetConsumerName(int index)
+        {
+            return string.Format("{0} #{1}", consumers[index].GetType().Name, index);
+        }
+
         public void Teardown()
         {
             Unbind();
@@ -99,6 +149,47 @@ namespace Kinovea.Pipeline
             log.DebugFormat("Ring buffer torn down.");
         }
 
+        /// <summary>
+        /// Claim the next slot for in-place writing by the producer.
+        /// Returns false if the slot is still being read, in which case the frame is counted as dropped and the producer must not write.
+        /// </summary>
+        public bool TryClaimSlot(out Frame entry)
+        {
+            //-------------------------
+            // Runs in producer thread.
+            //-------------------------
+
+            long produced = Produced();
+
+            bool claimed = ringBuffer.TryClaim(out entry);
+            if (!claimed)
+            {
+                lock (lockerDrops)
+                    drops++;
+
+                entry = null;
+            }
+            else
+            {
+                entry.ProducedTimestamp = produced;
+            }
+
+            return claimed;
+        }
+
+        /// <summary>
+        /// Publish the slot previously claimed by TryClaimSlot and filled in place.
+        /// </summary>
+        public void CommitSlot(Frame entry, int payloadLength)
+        {
+            //-------------------------
+            // Runs in producer thread.
+            //-------------------------
+
+            entry.PayloadLength = payloadLength;
+            Committed(entry);
+        }
+
         private void Bind()
         {
             // Make sure all consumers threads are running.
@@ -118,11 +209,19 @@ namespace Kinovea.Pipeline
 
             producer.FrameProduced += producer_FrameProduced;
 
+            IFrameSlotProducer slotProducer = producer as IFrameSlotProducer;
+            if (slotProducer != null)
+                slotProducer.SetPipeline(this);
+
             log.DebugFormat("Pipeline connected to producer and consumers.");
         }
 
         private void Unbind()
         {
+            IFrameSlotProducer slotProducer = producer as IFrameSlotProducer;
+            if (slotProducer != null)
+                slotProducer.ClearPipeline();
+
             producer.FrameProduced -= producer_FrameProduced;
             ringBuffer.ClearConsumers();
 
@@ -143,7 +242,11 @@ namespace Kinovea.Pipeline
             //if (benchmarkMode == BenchmarkMode.Heartbeat)
               //return;
 
-            frequencyCounter.Tick();
+            // In-place producers have already gone through TryClaimSlot/CommitSlot.
+            if (e.InPlace)
+                return;
+
+            long produced = Produced();
 
             // Claim the next slot in the ring buffer.
             Frame entry;
@@ -161,6 +264,7 @@ namespace Kinovea.Pipeline
             }
             else
             {
+                entry.ProducedTimestamp = produced;
                 WriteSlot(e.Buffer, e.PayloadLength, entry);
             }
         }
@@ -182,10 +286,46 @@ namespace Kinovea.Pipeline
                 // Unexpected
             }
 
-            ringBuffer.Commit();
+            Committed(entry);
             //commitbeat.Tick();
         }
 
+        private long Produced()
+        {
+            //-------------------------
+            // Runs in producer thread.
+            //-------------------------
+
+            long now = Stopwatch.GetTimestamp();
+
+            if (resetLatenciesAsked)
+            {
+                produceInterval.Reset();
+                produceToCommit.Reset();
+                lastProduced = 0;
+                resetLatenciesAsked = false;
+            }
+
+            if (lastProduced != 0)
+                produceInterval.RecordTicks(now - lastProduced);
+
+            lastProduced = now;
+            frequencyCounter.Tick();
+            return now;
+        }
+
+        private void Committed(Frame entry)
+        {
+            //-------------------------
+            // Runs in producer thread.
+            //-------------------------
+
+            // The timestamp must be written before the commit publishes the entry.
+            entry.CommittedTimestamp = Stopwatch.GetTimestamp();
+            produceToCommit.RecordTicks(entry.CommittedTimestamp - entry.ProducedTimestamp);
+            ringBuffer.Commit();
+        }
+
         #region Benchmarking support
         public void SetBenchmarkMode(BenchmarkMode benchmarkMode)
         {
@@ -195,7 +335,11 @@ namespace Kinovea.Pipeline
 
         public Dictionary<string, IBenchmarkCounter> StopBenchmark()
         {
-            return null;
+            Dictionary<string, IBenchmarkCounter> result = new Dictionary<string, IBenchmarkCounter>();
+            foreach (var pair in GetLatencyHistograms())
+                result.Add(pair.Key, pair.Value);
+
+            return result;
             /*foreach (BenchmarkCounterIntervals counter in counters.Values)
                 counter.Stop();
 
@@ -10,6 +10,7 @@ namespace Kinovea.Pipeline
         bool Started { get; }
         bool Active { get; }
         long ConsumerPosition { get; }
+        ConsumerLatencies Latencies { get; }
 
         void Run();
         void SetRingBuffer(RingBuffer buffer);
@@ -12,6 +12,7 @@ namespace Kinovea.Pipeline
         /// The camera received a new frame.
         /// The event is called from within the grabbing thread and the frame bytes are owned by grabbing.
         /// The event handler should make a copy of the bytes, push them to a queue and return as soon as possible.
+        /// Producers implementing IFrameSlotProducer raise the event with InPlace set when the frame was written directly in the pipeline.
         /// </summary>
         event EventHandler<FrameProducedEventArgs> FrameProduced;
     }
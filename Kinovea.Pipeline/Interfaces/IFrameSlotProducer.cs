@@ -0,0 +1,27 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Text;
+
+namespace Kinovea.Pipeline
+{
+    /// <summary>
+    /// A producer able to write frames directly into the ring buffer, avoiding the copy done on FrameProduced.
+    /// 
+    /// In the grabbing thread the producer calls pipeline.TryClaimSlot(), has the camera SDK or decoder fill the slot buffer, 
+    /// then calls pipeline.CommitSlot() and raises FrameProduced with InPlace set.
+    /// If the slot couldn't be claimed the frame is dropped, the producer should still raise FrameProduced with InPlace set.
+    /// </summary>
+    public interface IFrameSlotProducer : IFrameProducer
+    {
+        /// <summary>
+        /// Called by the pipeline when it is connected, before the producer is started. 
+        /// </summary>
+        void SetPipeline(FramePipeline pipeline);
+
+        /// <summary>
+        /// Called by the pipeline when it is disconnected. The producer must go back to the copy path.
+        /// </summary>
+        void ClearPipeline();
+    }
+}
@@ -0,0 +1,20 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Text;
+
+namespace Kinovea.Pipeline
+{
+    /// <summary>
+    /// How a consumer waits for the producer when it has consumed everything available.
+    /// Trades latency against CPU usage.
+    /// </summary>
+    public interface IWaitStrategy
+    {
+        /// <summary>
+        /// Wait until the position is committed by the producer, and return the producer position.
+        /// Implementations may return early with a position before the asked one, the caller must handle it.
+        /// </summary>
+        long WaitFor(long position, RingBuffer buffer);
+    }
+}
@@ -5,6 +5,7 @@ using System.Text;
 using Kinovea.Services;
 using System.Threading;
 using Kinovea.Pipeline.MemoryLayout;
+using Kinovea.Pipeline.WaitStrategies;
 
 namespace Kinovea.Pipeline
 {
@@ -13,6 +14,7 @@ namespace Kinovea.Pipeline
     /// Inspired by the disruptor pattern.
     /// 
     /// Preallocated buffer to avoid allocation and GC, and improve spatial locality.
+    /// The slot buffers are pinned so producers can fill them in place from native code.
     /// Constrain capacity to powers of two to use bitwise "&" rather than modulo when computing actual slot number.
     /// </summary>
     public class RingBuffer
@@ -36,9 +38,17 @@ namespace Kinovea.Pipeline
         private int capacity;
         private int remainderMask;
         private Random random = new Random();
-        private List<IFrameConsumer> consumers;
+        private IFrameConsumer[] consumers = new IFrameConsumer[0];
         private CacheLineStorageLong producerPosition = new CacheLineStorageLong(-1); // Last position written to by the producer.
+
+        // Gating sequence: cached minimum position of the active consumers, only touched by the producer.
+        // Stored in the middle of an array to keep it on its own cache line.
+        private long[] gatingPosition = new long[2 * gatingIndex];
+        private const int gatingIndex = CacheLine.Size / sizeof(long);
         private BenchmarkMode benchmarkMode;
+        private IWaitStrategy defaultWaitStrategy = new SpinThenYieldWaitStrategy();
+        private object commitLocker = new object();
+        private int blockedWaiters;
         private bool allocated;
         private static readonly log4net.ILog log = log4net.LogManager.GetLogger(System.Reflection.MethodBase.GetCurrentMethod().DeclaringType);
 
@@ -50,6 +60,7 @@ namespace Kinovea.Pipeline
             try
             {
                 remainderMask = capacity - 1;
+                gatingPosition[gatingIndex] = -1;
 
                 this.capacity = capacity;
                 slots = new Frame[capacity];
@@ -70,16 +81,22 @@ namespace Kinovea.Pipeline
 
         public void SetConsumers(List<IFrameConsumer> consumers)
         {
-            this.consumers = consumers;
+            this.consumers = consumers.ToArray();
         }
 
         public void ClearConsumers()
         {
-            this.consumers.Clear();
+            this.consumers = new IFrameConsumer[0];
         }
 
         public void Teardown()
         {
+            foreach (Frame slot in slots)
+            {
+                if (slot != null)
+                    slot.Release();
+            }
+
             Array.Clear(slots, 0, slots.Length);
             GC.Collect();
         }
@@ -144,6 +161,15 @@ namespace Kinovea.Pipeline
             // The producer has finished stuffing the bytes in the Frame.
             // Mark the position as available for reading.
             producerPosition.Data = producerPosition.Data + 1;
+
+            // Wake up consumers using the blocking wait strategy, if any.
+            // The fence makes sure the new position is visible before we read the waiter count.
+            Thread.MemoryBarrier();
+            if (blockedWaiters > 0)
+            {
+                lock (commitLocker)
+                    Monitor.PulseAll(commitLocker);
+            }
         }
 
         private void WaitForReaders(long position)
@@ -184,29 +210,89 @@ namespace Kinovea.Pipeline
             }
 
             // Test whether all active readers have read past the wrap point.
-            long mustHaveRead = position - slots.Length;
-            return consumers.All(c => !c.Active || c.ConsumerPosition >= mustHaveRead);
+            // Consumers only move forward so the cached minimum is a lower bound of their actual positions.
+            // It's only refreshed when the producer would otherwise wrap over it.
+            long mustHaveRead = position - capacity;
+            if (mustHaveRead <= gatingPosition[gatingIndex])
+                return true;
+
+            long minimum = GetMinimumConsumerPosition(position);
+            gatingPosition[gatingIndex] = minimum;
+            return mustHaveRead <= minimum;
+        }
+
+        private long GetMinimumConsumerPosition(long position)
+        {
+            //-------------------------
+            // Runs in producer thread.
+            //-------------------------
+
+            // Consumers activating later start at the producer position minus one, 
+            // so this is the most we can assume if no consumer is active.
+            long minimum = position - 2;
+
+            IFrameConsumer[] consumers = this.consumers;
+            for (int i = 0; i < consumers.Length; i++)
+            {
+                IFrameConsumer consumer = consumers[i];
+                if (!consumer.Active)
+                    continue;
+
+                long consumerPosition = consumer.ConsumerPosition;
+                if (consumerPosition < minimum)
+                    minimum = consumerPosition;
+            }
+
+            return minimum;
         }
         #endregion
 
         #region Consumer barrier
         public long WaitFor(long position)
+        {
+            return WaitFor(position, defaultWaitStrategy);
+        }
+
+        public long WaitFor(long position, IWaitStrategy waitStrategy)
         {
             //---------------------------
             // Runs in a consumer thread.
             //---------------------------
 
-            // In the case of a fast consumer, this method will Yield the consumer thread until the asked position is written.
+            // In the case of a fast consumer, this method will wait according to the strategy until the asked position is written.
             // In the case of a slow consumer, this method will return instantly with the current producer position,
             // this way the consumer can consume all the frames up to the current position on its own, in a tight loop.
-            // Thread context switch via Sleep() is not critical here, because it can only happen when the consumer is 
-            // faster than the producer anyway, so it should have time to catch-up later on.
-            while (position > producerPosition.Data)
+            long available = producerPosition.Data;
+            if (position <= available)
+                return available;
+
+            return waitStrategy.WaitFor(position, this);
+        }
+
+        /// <summary>
+        /// Block the calling thread until the position is committed or the timeout expires.
+        /// Returns the producer position, which may be before the asked position in case of timeout.
+        /// </summary>
+        internal long BlockUntilCommitted(long position, int timeoutMilliseconds)
+        {
+            //---------------------------
+            // Runs in a consumer thread.
+            //---------------------------
+
+            lock (commitLocker)
             {
-                //Thread.Yield(); // Only in .NET 4.0
-                Thread.Sleep(0);
+                blockedWaiters++;
+                Thread.MemoryBarrier();
+
+                while (position > producerPosition.Data)
+                {
+                    if (!Monitor.Wait(commitLocker, timeoutMilliseconds))
+                        break;
+                }
+
+                blockedWaiters--;
             }
-            
+
             return producerPosition.Data;
         }
 
@@ -0,0 +1,22 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Text;
+
+namespace Kinovea.Pipeline.WaitStrategies
+{
+    /// <summary>
+    /// Block the consumer thread until the producer commits.
+    /// Does not use any CPU while waiting, at the cost of a thread wake up on each frame.
+    /// The wait times out periodically so the consumer can notice deactivation even if the producer is stopped.
+    /// </summary>
+    public class BlockingWaitStrategy : IWaitStrategy
+    {
+        private const int timeoutMilliseconds = 100;
+
+        public long WaitFor(long position, RingBuffer buffer)
+        {
+            return buffer.BlockUntilCommitted(position, timeoutMilliseconds);
+        }
+    }
+}
@@ -0,0 +1,27 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Text;
+using System.Threading;
+
+namespace Kinovea.Pipeline.WaitStrategies
+{
+    /// <summary>
+    /// Spin without ever giving up the core.
+    /// Lowest latency but burns a full core for as long as the consumer is active.
+    /// Only use it when there are more cores than busy threads.
+    /// </summary>
+    public class BusySpinWaitStrategy : IWaitStrategy
+    {
+        public long WaitFor(long position, RingBuffer buffer)
+        {
+            long available;
+            while (position > (available = buffer.ProducerPosition))
+            {
+                Thread.SpinWait(1);
+            }
+
+            return available;
+        }
+    }
+}
@@ -0,0 +1,40 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Text;
+using System.Threading;
+
+namespace Kinovea.Pipeline.WaitStrategies
+{
+    /// <summary>
+    /// Spin for a short while, then yield the rest of the time slice between checks.
+    /// Low latency, the core is given to other threads if they need it but still appears busy.
+    /// This is the default strategy.
+    /// </summary>
+    public class SpinThenYieldWaitStrategy : IWaitStrategy
+    {
+        private const int spinTries = 100;
+
+        public long WaitFor(long position, RingBuffer buffer)
+        {
+            int counter = spinTries;
+            long available;
+
+            while (position > (available = buffer.ProducerPosition))
+            {
+                if (counter > 0)
+                {
+                    counter--;
+                    Thread.SpinWait(1);
+                }
+                else
+                {
+                    //Thread.Yield(); // Only in .NET 4.0
+                    Thread.Sleep(0);
+                }
+            }
+
+            return available;
+        }
+    }
+}
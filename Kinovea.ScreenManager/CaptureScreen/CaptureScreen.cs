@@ -268,6 +268,7 @@ namespace Kinovea.ScreenManager
                 pipelineManager = null;
             }
 
+            consumerDisplay.Dispose();
             consumerDisplay = null;
 
             nonGrabbingInteractionTimer.Stop();
@@ -759,6 +760,8 @@ namespace Kinovea.ScreenManager
             if (!cameraConnected)
                 return;
             
+            // The image processor works on the full resolution image, otherwise only the displayed size matters.
+            consumerDisplay.DisplaySize = imageProcessor.Active ? Size.Empty : viewportController.DisplayRectangle.Size;
             consumerDisplay.ConsumeOne();
             Bitmap fresh = consumerDisplay.Bitmap;
 
@@ -911,6 +914,10 @@ namespace Kinovea.ScreenManager
             if(!OverwriteCheck(path))
                 return;
 
+            // The display image may have been decoded at reduced resolution, get the same frame at full resolution.
+            if (cameraConnected)
+                consumerDisplay.DecodeFullResolution();
+
             //Actual save.
             Bitmap outputImage = BitmapHelper.Copy(consumerDisplay.Bitmap);
             if(outputImage == null)
@@ -10,16 +10,18 @@ using Kinovea.Pipeline;
 using System.Drawing.Imaging;
 using System.Runtime.InteropServices;
 using System.Diagnostics;
-using TurboJpegNet;
 using Kinovea.Video;
+using Kinovea.Video.FFMpeg;
 
 namespace Kinovea.ScreenManager
 {
     /// <summary>
     /// Pipeline consumer wrapping the main UI thread.
     /// Convert the sample buffer to RGB24, then to Bitmap for display purposes.
+    /// JPEG samples are decoded at a reduced size when the display is smaller than the image, 
+    /// then enlarged back to the bitmap size.
     /// </summary>
-    public class ConsumerDisplay : IFrameConsumer
+    public class ConsumerDisplay : IFrameConsumer, IDisposable
     {
         public bool Started
         {
@@ -40,24 +42,58 @@ namespace Kinovea.ScreenManager
             }
         }
 
+        public ConsumerLatencies Latencies
+        {
+            get { return latencies; }
+        }
+
         public Bitmap Bitmap
         {
             get { return bitmap; }
         }
 
+        /// <summary>
+        /// Size at which the images are shown on screen. 
+        /// Images may be decoded at a lower resolution as long as they still cover this size.
+        /// Set to Size.Empty to always decode at full resolution.
+        /// </summary>
+        public Size DisplaySize
+        {
+            get { return displaySize; }
+            set { displaySize = value; }
+        }
+
         // Frame memory storage
         private RingBuffer buffer;
         private int frameLength;
         private ImageDescriptor imageDescriptor;
         private int width;
         private int height;
-        private int pitch;
         private Rectangle rect;
         private Bitmap bitmap;
-        private byte[] decoded;
+        private Bitmap scaledBitmap;
+        private Size displaySize;
+        private byte[] reducedPayload;
+        private int reducedPayloadLength;
+        private bool reduced;
+        private JPEGDecoder jpegDecoder = new JPEGDecoder();
+        private ConsumerLatencies latencies = new ConsumerLatencies();
         private bool allocated;
         private static readonly log4net.ILog log = log4net.LogManager.GetLogger(System.Reflection.MethodBase.GetCurrentMethod().DeclaringType);
 
+        public void Dispose()
+        {
+            if (bitmap != null)
+            {
+                bitmap.Dispose();
+                bitmap = null;
+            }
+
+            DisposeScaledBitmap();
+            jpegDecoder.Dispose();
+            allocated = false;
+        }
+
         public void Run()
         {
             throw new NotSupportedException();
@@ -92,9 +128,9 @@ namespace Kinovea.ScreenManager
                 bitmap.Dispose();
                 bitmap = null;
             }
-            
-            if (decoded != null)
-                decoded = null;
+
+            DisposeScaledBitmap();
+            reduced = false;
 
             GC.Collect();
 
@@ -106,9 +142,6 @@ namespace Kinovea.ScreenManager
                 width = imageDescriptor.Width;
                 height = imageDescriptor.Height;
                 rect = new Rectangle(0, 0, width, height);
-                pitch = width * 3;
-
-                decoded = new byte[pitch * height];
                 bitmap = new Bitmap(width, height, PixelFormat.Format24bppRgb);
 
                 allocated = true;
@@ -138,7 +171,23 @@ namespace Kinovea.ScreenManager
             long next = buffer.ProducerPosition;
             
             Frame entry = buffer.GetEntry(next);
+            long pickup = Stopwatch.GetTimestamp();
             ProcessEntry(next, entry);
+            latencies.Record(entry, pickup, Stopwatch.GetTimestamp());
+        }
+
+        /// <summary>
+        /// Decode the frame currently published in Bitmap again at full resolution, if it was decoded at a reduced size.
+        /// The ring buffer slot may have been reused since, so this works from a copy of the compressed frame.
+        /// Does not change DisplaySize, the next call to ConsumeOne decodes at the display size again.
+        /// </summary>
+        public void DecodeFullResolution()
+        {
+            if (!allocated || !reduced)
+                return;
+
+            jpegDecoder.Decode(reducedPayload, reducedPayloadLength, bitmap);
+            reduced = false;
         }
 
         private void ProcessEntry(long position, Frame entry)
@@ -146,44 +195,67 @@ namespace Kinovea.ScreenManager
             if (!allocated)
                 return;
 
+            // Only RGB24 buffers honor the bottom-up flag, RGB32 and Y800 buffers have always been displayed as is.
             switch (imageDescriptor.Format)
             {
                 case Video.ImageFormat.RGB24:
-                    BitmapHelper.FillFromRGB24(bitmap, rect, imageDescriptor.TopDown, entry.Buffer);
+                    PixelConverter.FillFromRGB24(bitmap, rect.Size, imageDescriptor.TopDown, entry.Buffer, 1);
                     break;
                 case Video.ImageFormat.RGB32:
-                    BitmapHelper.FillFromRGB32(bitmap, rect, imageDescriptor.TopDown, entry.Buffer);
+                    PixelConverter.FillFromRGB32(bitmap, rect.Size, true, entry.Buffer, 1);
                     break;
                 case Video.ImageFormat.Y800:
-                    BitmapHelper.FillFromY800(bitmap, rect, imageDescriptor.TopDown, entry.Buffer);
+                    PixelConverter.FillFromY800(bitmap, rect.Size, true, entry.Buffer, 1);
                     break;
                 case Video.ImageFormat.JPEG:
-                    FillBitmapJPEG(entry.Buffer, entry.PayloadLength);
+                    FillFromJPEG(entry);
                     break;
             }
         }
 
-        private void FillBitmapJPEG(byte[] buffer, int payloadLength)
+        /// <summary>
+        /// Decode the JPEG at the smallest DCT scale that still covers the display, and enlarge it back to the bitmap size.
+        /// Decoding is the expensive part, the enlargement is a plain pixel replication.
+        /// </summary>
+        private void FillFromJPEG(Frame entry)
         {
-            // Convert JPEG to RGB24 buffer then to bitmap.
+            int factor = JPEGDecoder.GetScalingFactor(rect.Size, displaySize);
+            if (factor == 1)
+            {
+                jpegDecoder.Decode(entry.Buffer, entry.PayloadLength, bitmap);
+                reduced = false;
+                return;
+            }
 
-            IntPtr handle = tjnet.tjInitDecompress();
+            Size scaledSize = JPEGDecoder.GetScaledSize(rect.Size, factor);
+            if (scaledBitmap == null || scaledBitmap.Size != scaledSize)
+            {
+                DisposeScaledBitmap();
+                scaledBitmap = new Bitmap(scaledSize.Width, scaledSize.Height, PixelFormat.Format24bppRgb);
+            }
 
-            uint jpegSize = (uint)payloadLength;
-            int width;
-            int height;
-            TJSAMP jpegSubsamp;
-            tjnet.tjDecompressHeader2(handle, buffer, jpegSize, out width, out height, out jpegSubsamp);
+            Size decoded = jpegDecoder.Decode(entry.Buffer, entry.PayloadLength, scaledBitmap);
+            if (decoded != scaledSize)
+                return;
 
-            tjnet.tjDecompress2(handle, buffer, jpegSize, decoded, width, pitch, height, TJPF.TJPF_BGR, TJFLAG.TJFLAG_FASTDCT);
-            
-            tjnet.tjDestroy(handle);
+            PixelConverter.Expand(scaledBitmap, bitmap, factor);
+
+            // Keep the compressed frame for DecodeFullResolution.
+            if (reducedPayload == null || reducedPayload.Length < entry.PayloadLength)
+                reducedPayload = new byte[entry.Buffer.Length];
+
+            Buffer.BlockCopy(entry.Buffer, 0, reducedPayload, 0, entry.PayloadLength);
+            reducedPayloadLength = entry.PayloadLength;
+            reduced = true;
+        }
+
+        private void DisposeScaledBitmap()
+        {
+            if (scaledBitmap == null)
+                return;
 
-            // Encapsulate into bitmap.
-            // Fixme: do we need the copy here? What about getting an IntPtr from tjnet and setting it to scan0?
-            BitmapData bmpData = bitmap.LockBits(rect, ImageLockMode.ReadWrite, bitmap.PixelFormat);
-            Marshal.Copy(decoded, 0, bmpData.Scan0, bmpData.Stride * bitmap.Height);
-            bitmap.UnlockBits(bmpData);
+            scaledBitmap.Dispose();
+            scaledBitmap = null;
         }
     }
 }
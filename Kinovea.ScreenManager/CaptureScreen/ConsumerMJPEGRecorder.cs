@@ -5,6 +5,7 @@ using System;
 using Kinovea.Video;
 using Kinovea.Video.FFMpeg;
 using System.Drawing;
+using Kinovea.Services;
 
 namespace Kinovea.ScreenManager
 {
@@ -12,6 +13,8 @@ namespace Kinovea.ScreenManager
     /// ConsumerMJPEGRecorder. Save samples to an MJPEG file (in MP4 container).
     /// The recorder is format agnostic, the format is simply passed along to the writer.
     /// The writer will decide if resampling and encoding are needed.
+    /// If uncompressed recording is enabled in the preferences, frames are written as is to an AVI file instead,
+    /// and the file is compressed in the background once the take is over.
     /// </summary>
     public class ConsumerMJPEGRecorder : AbstractConsumer
     {
@@ -20,9 +23,39 @@ namespace Kinovea.ScreenManager
             get { return filename; }
         }
 
+        /// <summary>
+        /// Number of chunks waiting to be written to disk. A queue that keeps growing means the disk is too slow.
+        /// </summary>
+        public int WriteQueueDepth
+        {
+            get 
+            {
+                if (rawWriter != null)
+                    return rawWriter.WriteQueueDepth;
+                
+                return writer != null ? writer.WriteQueueDepth : 0; 
+            }
+        }
+
+        /// <summary>
+        /// Average time spent in a single disk write, in milliseconds.
+        /// </summary>
+        public double WriteLatency
+        {
+            get
+            {
+                if (rawWriter != null)
+                    return rawWriter.WriteLatency;
+
+                return writer != null ? writer.WriteLatency : 0;
+            }
+        }
+
         private ImageDescriptor imageDescriptor;
         private MJPEGWriter writer;
+        private RawWriter rawWriter;
         private string filename;
+        private double interval;
         
         public void SetImageDescriptor(ImageDescriptor imageDescriptor)
         {
@@ -39,8 +72,12 @@ namespace Kinovea.ScreenManager
             if (writer != null)
                 writer.Dispose();
 
-            writer = new MJPEGWriter();
-            
+            if (rawWriter != null)
+                rawWriter.Dispose();
+
+            writer = null;
+            rawWriter = null;
+
             VideoInfo info = new VideoInfo();
             info.OriginalSize = new Size(imageDescriptor.Width, imageDescriptor.Height);
 
@@ -52,23 +89,53 @@ namespace Kinovea.ScreenManager
             if (interval < 10)
                 interval = 1000.0/30;
 
-            SaveResult result = writer.OpenSavingContext(filename, info, formatString, interval);
+            this.interval = interval;
+
+            if (PreferencesManager.CapturePreferences.UncompressedRecording)
+            {
+                rawWriter = new RawWriter();
+                return rawWriter.OpenSavingContext(filename, info, imageDescriptor.Format, interval);
+            }
+
+            writer = new MJPEGWriter();
+
+            // Encode frames in parallel, but leave some cores to the producer and the display.
+            int encoders = Math.Max(1, Math.Min(Environment.ProcessorCount - 2, 4));
+
+            SaveResult result = writer.OpenSavingContext(filename, info, formatString, imageDescriptor.Format, interval, encoders);
 
             return result;
         }
 
         protected override void AfterDeactivate()
         {
-            writer.CloseSavingContext(true);
-            writer.Dispose();
-            writer = null;
+            if (rawWriter != null)
+            {
+                rawWriter.CloseSavingContext(true);
+                rawWriter.Dispose();
+                rawWriter = null;
+
+                // JPEG samples are already compressed.
+                if (PreferencesManager.CapturePreferences.CompressAfterRecording && imageDescriptor.Format != ImageFormat.JPEG)
+                    RecordingCompressor.Enqueue(filename, interval);
+            }
+
+            if (writer != null)
+            {
+                writer.CloseSavingContext(true);
+                writer.Dispose();
+                writer = null;
+            }
 
             base.AfterDeactivate();
         }
 
         protected override void ProcessEntry(long position, Frame entry)
         {
-            writer.SaveFrame(imageDescriptor.Format, entry.Buffer, entry.PayloadLength);
+            if (rawWriter != null)
+                rawWriter.SaveFrame(imageDescriptor.Format, entry.Buffer, entry.PayloadLength);
+            else
+                writer.SaveFrame(imageDescriptor.Format, entry.Buffer, entry.PayloadLength);
         }
     }
 }
@@ -0,0 +1,128 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Text;
+using System.Drawing;
+using System.Drawing.Imaging;
+using TurboJpegNet;
+
+namespace Kinovea.ScreenManager
+{
+    /// <summary>
+    /// JPEG decoder for the display of JPEG cameras.
+    /// Keeps a single TurboJPEG decompressor alive for the lifetime of the object and decodes directly into the bitmap.
+    /// If the bitmap is smaller than the JPEG image, the image is decoded at the largest DCT scaling factor that fits (1/2, 1/4 or 1/8),
+    /// which is much cheaper than a full decode followed by a resize.
+    /// </summary>
+    public class JPEGDecoder : IDisposable
+    {
+        private IntPtr handle;
+        private static readonly int[] scalingDenominators = new int[] { 1, 2, 4, 8 };
+        private static readonly log4net.ILog log = log4net.LogManager.GetLogger(System.Reflection.MethodBase.GetCurrentMethod().DeclaringType);
+
+        ~JPEGDecoder()
+        {
+            Dispose(false);
+        }
+
+        public void Dispose()
+        {
+            Dispose(true);
+            GC.SuppressFinalize(this);
+        }
+
+        protected virtual void Dispose(bool disposing)
+        {
+            if (handle != IntPtr.Zero)
+            {
+                tjnet.tjDestroy(handle);
+                handle = IntPtr.Zero;
+            }
+        }
+
+        /// <summary>
+        /// Decode the JPEG into the top-left corner of the bitmap.
+        /// The bitmap must be RGB24. Returns the size of the decoded image, or an empty size on error.
+        /// </summary>
+        public Size Decode(byte[] buffer, int payloadLength, Bitmap bitmap)
+        {
+            if (handle == IntPtr.Zero)
+                handle = tjnet.tjInitDecompress();
+
+            uint jpegSize = (uint)payloadLength;
+            int width;
+            int height;
+            TJSAMP jpegSubsamp;
+            int header = tjnet.tjDecompressHeader2(handle, buffer, jpegSize, out width, out height, out jpegSubsamp);
+            if (header != 0 || width <= 0 || height <= 0)
+            {
+                // Corrupt or truncated frame, skip it.
+                log.Debug("The JPEG header could not be read.");
+                return Size.Empty;
+            }
+
+            Size size = GetScaledSize(new Size(width, height), bitmap.Size);
+            if (size == Size.Empty)
+            {
+                log.ErrorFormat("The JPEG image ({0}x{1}) cannot be scaled down to the bitmap ({2}x{3}).", width, height, bitmap.Width, bitmap.Height);
+                return Size.Empty;
+            }
+
+            Rectangle rect = new Rectangle(Point.Empty, size);
+            BitmapData bmpData = bitmap.LockBits(rect, ImageLockMode.WriteOnly, bitmap.PixelFormat);
+
+            int result = NativeMethods.tjDecompress2(handle, buffer, jpegSize, bmpData.Scan0, size.Width, bmpData.Stride, size.Height, (int)TJPF.TJPF_BGR, (int)TJFLAG.TJFLAG_FASTDCT);
+
+            bitmap.UnlockBits(bmpData);
+
+            return result == 0 ? size : Size.Empty;
+        }
+
+        /// <summary>
+        /// Returns the DCT scaling denominator giving the smallest image that still covers the display size.
+        /// Returns 1 if the display size is empty or larger than the image.
+        /// </summary>
+        public static int GetScalingFactor(Size imageSize, Size displaySize)
+        {
+            if (displaySize.Width <= 0 || displaySize.Height <= 0)
+                return 1;
+
+            int factor = 1;
+            foreach (int denominator in scalingDenominators)
+            {
+                Size size = GetScaledSize(imageSize, denominator);
+                if (size.Width < displaySize.Width || size.Height < displaySize.Height)
+                    break;
+
+                factor = denominator;
+            }
+
+            return factor;
+        }
+
+        /// <summary>
+        /// Returns the size of the image decoded with the given DCT scaling denominator.
+        /// Uses the same rounding as TurboJPEG.
+        /// </summary>
+        public static Size GetScaledSize(Size imageSize, int denominator)
+        {
+            return new Size((imageSize.Width + denominator - 1) / denominator, (imageSize.Height + denominator - 1) / denominator);
+        }
+
+        /// <summary>
+        /// Returns the largest size reachable by DCT scaling that fits in the target, or an empty size if none does.
+        /// Uses the same rounding as TurboJPEG.
+        /// </summary>
+        public static Size GetScaledSize(Size imageSize, Size targetSize)
+        {
+            foreach (int denominator in scalingDenominators)
+            {
+                Size size = GetScaledSize(imageSize, denominator);
+                if (size.Width <= targetSize.Width && size.Height <= targetSize.Height)
+                    return size;
+            }
+
+            return Size.Empty;
+        }
+    }
+}
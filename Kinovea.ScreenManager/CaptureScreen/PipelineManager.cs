@@ -6,6 +6,7 @@ using Kinovea.Pipeline;
 using Kinovea.Services;
 using Kinovea.Pipeline.Consumers;
 using Kinovea.Video;
+using System.IO;
 
 namespace Kinovea.ScreenManager
 {
@@ -33,6 +34,7 @@ namespace Kinovea.ScreenManager
         private ConsumerDisplay consumerDisplay;
         private ConsumerMJPEGRecorder consumerRecord;
         private List<IFrameConsumer> consumers = new List<IFrameConsumer>();
+        private static readonly log4net.ILog log = log4net.LogManager.GetLogger(System.Reflection.MethodBase.GetCurrentMethod().DeclaringType);
 
         public void Connect(ImageDescriptor imageDescriptor, IFrameProducer producer, ConsumerDisplay consumerDisplay, ConsumerMJPEGRecorder consumerRecord)
         {
@@ -76,6 +78,7 @@ namespace Kinovea.ScreenManager
         public SaveResult StartRecord(string filepath, double interval)
         {
             pipeline.ResetDrops();
+            pipeline.ResetLatencies();
             
             SaveResult result = consumerRecord.Prepare(filepath, interval);
             if (result == SaveResult.Success)
@@ -87,6 +90,38 @@ namespace Kinovea.ScreenManager
         public void StopRecord()
         {
             consumerRecord.Deactivate();
+            DumpLatencies();
+        }
+
+        /// <summary>
+        /// Returns the per-stage latency histograms since the start of the last recording, or null if not connected.
+        /// </summary>
+        public Dictionary<string, LatencyHistogram> GetLatencyHistograms()
+        {
+            return pipeline == null ? null : pipeline.GetLatencyHistograms();
+        }
+
+        private void DumpLatencies()
+        {
+            // Keep the histograms of the last recording around for diagnosing drops.
+            Dictionary<string, LatencyHistogram> histograms = pipeline.GetLatencyHistograms();
+
+            foreach (var pair in histograms)
+            {
+                LatencyHistogram h = pair.Value;
+                log.DebugFormat("{0}: {1} frames, median: {2} µs, 99th percentile: {3} µs, max: {4} µs.",
+                    pair.Key, h.Count, h.GetValueAtPercentile(50), h.GetValueAtPercentile(99), h.Max);
+            }
+
+            try
+            {
+                string filename = Path.Combine(Software.TempDirectory, "CaptureLatencies.json");
+                LatencyHistogramExporter.ExportJSON(filename, histograms);
+            }
+            catch (Exception e)
+            {
+                log.ErrorFormat("Latency histograms could not be saved. {0}", e.Message);
+            }
         }
 
         private void producer_FrameProduced(object sender, FrameProducedEventArgs e)
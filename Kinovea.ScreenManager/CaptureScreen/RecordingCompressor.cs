@@ -0,0 +1,213 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.Drawing;
+using System.Drawing.Imaging;
+using System.IO;
+using System.Runtime.InteropServices;
+using System.Threading;
+using Kinovea.Video;
+using Kinovea.Video.FFMpeg;
+
+namespace Kinovea.ScreenManager
+{
+    /// <summary>
+    /// Compress uncompressed recordings to MJPEG once the take is over.
+    /// Files are processed one after the other on a single low priority thread, so an ongoing recording keeps most of the machine.
+    /// The compressed file is written next to the original and replaces it under the same name when done.
+    /// If anything fails the uncompressed file is left untouched and the partial compressed file is deleted.
+    /// </summary>
+    public static class RecordingCompressor
+    {
+        private class Job
+        {
+            public string Filename;
+            public double Interval;
+        }
+
+        private static Queue<Job> pending = new Queue<Job>();
+        private static Thread worker;
+        private static object locker = new object();
+        private static readonly log4net.ILog log = log4net.LogManager.GetLogger(System.Reflection.MethodBase.GetCurrentMethod().DeclaringType);
+
+        /// <summary>
+        /// Schedule the compression of an uncompressed recording.
+        /// The interval is the one the recording was made with, the reader only has a quick estimate of it when the file is opened.
+        /// </summary>
+        public static void Enqueue(string filename, double interval)
+        {
+            lock (locker)
+            {
+                pending.Enqueue(new Job { Filename = filename, Interval = interval });
+                if (worker != null)
+                    return;
+
+                worker = new Thread(Work) { IsBackground = true, Priority = ThreadPriority.BelowNormal };
+                worker.Name = "RecordingCompressor";
+                worker.Start();
+            }
+        }
+
+        private static void Work()
+        {
+            while (true)
+            {
+                Job job;
+                lock (locker)
+                {
+                    if (pending.Count == 0)
+                    {
+                        worker = null;
+                        return;
+                    }
+
+                    job = pending.Dequeue();
+                }
+
+                try
+                {
+                    Compress(job.Filename, job.Interval);
+                }
+                catch (Exception e)
+                {
+                    log.ErrorFormat("Error while compressing {0}. {1}", Path.GetFileName(job.Filename), e.Message);
+                }
+            }
+        }
+
+        private static void Compress(string filename, double interval)
+        {
+            string tempFilename = Path.Combine(Path.GetDirectoryName(filename), Path.GetFileNameWithoutExtension(filename) + ".compressing.avi");
+            Stopwatch stopwatch = Stopwatch.StartNew();
+            bool success = false;
+            int frames = 0;
+
+            VideoReaderFFMpeg reader = new VideoReaderFFMpeg();
+            MJPEGWriter writer = null;
+
+            try
+            {
+                if (reader.Open(filename) != OpenVideoResult.Success)
+                {
+                    log.ErrorFormat("Uncompressed recording could not be opened: {0}", Path.GetFileName(filename));
+                    return;
+                }
+
+                Kinovea.Video.ImageFormat format = Kinovea.Video.ImageFormat.RGB32;
+                byte[] buffer = null;
+                int rowSize = 0;
+                bool failed = false;
+
+                foreach (VideoFrame frame in reader.FrameEnumerator())
+                {
+                    if (frame == null || frame.Image == null)
+                    {
+                        failed = true;
+                        break;
+                    }
+
+                    Bitmap image = frame.Image;
+                    if (writer == null)
+                    {
+                        // The reader gives grayscale sources as 8 bpp images, these go to the encoder without conversion.
+                        bool grayscale = image.PixelFormat == PixelFormat.Format8bppIndexed;
+                        format = grayscale ? Kinovea.Video.ImageFormat.Y800 : Kinovea.Video.ImageFormat.RGB32;
+                        rowSize = image.Width * (grayscale ? 1 : 4);
+                        buffer = new byte[rowSize * image.Height];
+
+                        VideoInfo info = new VideoInfo();
+                        info.OriginalSize = image.Size;
+
+                        writer = new MJPEGWriter();
+                        SaveResult result = writer.OpenSavingContext(tempFilename, info, "avi", format, interval);
+                        if (result != SaveResult.Success)
+                        {
+                            log.ErrorFormat("Compressed file could not be created: {0}", result);
+                            failed = true;
+                            break;
+                        }
+                    }
+
+                    CopyImage(image, buffer, rowSize);
+                    if (writer.SaveFrame(format, buffer, buffer.Length) != SaveResult.Success)
+                    {
+                        failed = true;
+                        break;
+                    }
+
+                    frames++;
+                }
+
+                success = !failed && frames > 0;
+            }
+            finally
+            {
+                if (writer != null)
+                {
+                    if (writer.CloseSavingContext(success) != SaveResult.Success)
+                        success = false;
+
+                    writer.Dispose();
+                }
+
+                reader.Close();
+                reader.Dispose();
+
+                // Also reached when the reader or the writer throws.
+                if (!success)
+                {
+                    log.ErrorFormat("Compression of {0} failed. The uncompressed file is kept.", Path.GetFileName(filename));
+                    DeleteTemporary(tempFilename);
+                }
+            }
+
+            if (!success)
+                return;
+
+            try
+            {
+                File.Delete(filename);
+                File.Move(tempFilename, filename);
+            }
+            catch (Exception e)
+            {
+                // The file might have been opened in a player in the meantime.
+                log.ErrorFormat("Uncompressed file could not be replaced. {0}", e.Message);
+                DeleteTemporary(tempFilename);
+                return;
+            }
+
+            log.DebugFormat("Compressed {0}: {1} frames in {2} ms.", Path.GetFileName(filename), frames, stopwatch.ElapsedMilliseconds);
+        }
+
+        /// <summary>
+        /// Copy the image rows into a tightly packed buffer, as expected by the writer.
+        /// </summary>
+        private static void CopyImage(Bitmap image, byte[] buffer, int rowSize)
+        {
+            Rectangle rect = new Rectangle(0, 0, image.Width, image.Height);
+            BitmapData data = image.LockBits(rect, ImageLockMode.ReadOnly, image.PixelFormat);
+
+            for (int i = 0; i < image.Height; i++)
+            {
+                IntPtr row = new IntPtr(data.Scan0.ToInt64() + (long)i * data.Stride);
+                Marshal.Copy(row, buffer, i * rowSize, rowSize);
+            }
+
+            image.UnlockBits(data);
+        }
+
+        private static void DeleteTemporary(string tempFilename)
+        {
+            try
+            {
+                if (File.Exists(tempFilename))
+                    File.Delete(tempFilename);
+            }
+            catch (Exception e)
+            {
+                log.ErrorFormat("Temporary file could not be deleted. {0}", e.Message);
+            }
+        }
+    }
+}
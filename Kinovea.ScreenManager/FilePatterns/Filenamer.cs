@@ -85,6 +85,10 @@ namespace Kinovea.ScreenManager
 
         public static string GetVideoFileExtension()
         {
+            // Uncompressed recordings are always stored in AVI.
+            if (PreferencesManager.CapturePreferences.UncompressedRecording)
+                return ".avi";
+
             switch (PreferencesManager.CapturePreferences.CapturePathConfiguration.VideoFormat)
             {
                 case KinoveaVideoFormat.MKV: return ".mkv";
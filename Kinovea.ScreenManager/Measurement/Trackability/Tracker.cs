@@ -53,10 +53,10 @@ namespace Kinovea.ScreenManager
             BitmapData imageData = image.LockBits(imageBounds, ImageLockMode.ReadOnly, image.PixelFormat );
             BitmapData templateData = template.LockBits(templateBounds, ImageLockMode.ReadOnly, template.PixelFormat );
             
-            Image<Bgra, Byte> cvImage = new Image<Bgra, Byte>(imageData.Width, imageData.Height, imageData.Stride, imageData.Scan0);
-            Image<Bgra, Byte> cvTemplate = new Image<Bgra, Byte>(templateData.Width, templateData.Height, templateData.Stride, templateData.Scan0);
+            CvArray<Byte> cvImage = WrapImage(imageData);
+            CvArray<Byte> cvTemplate = WrapImage(templateData);
             
-            cvImage.ROI = searchZone;
+            CvInvoke.cvSetImageROI(cvImage.Ptr, searchZone);
             
             int similarityMapWidth = searchZone.Width - template.Width + 1;
             int similarityMapHeight = searchZone.Height - template.Height + 1;
@@ -78,5 +78,17 @@ namespace Kinovea.ScreenManager
             
             return new TrackResult(maxSimilarity, location);
         }
+        
+        /// <summary>
+        /// Wraps locked bitmap data into an OpenCV image without copy.
+        /// Grayscale indexed images are matched on their single channel, other images are expected 32 bpp.
+        /// </summary>
+        public static CvArray<Byte> WrapImage(BitmapData data)
+        {
+            if(data.PixelFormat == PixelFormat.Format8bppIndexed)
+                return new Image<Gray, Byte>(data.Width, data.Height, data.Stride, data.Scan0);
+            else
+                return new Image<Bgra, Byte>(data.Width, data.Height, data.Stride, data.Scan0);
+        }
     }
 }
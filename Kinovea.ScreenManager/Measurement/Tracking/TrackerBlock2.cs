@@ -27,6 +27,7 @@ using System.IO;
 using Emgu.CV;
 using Emgu.CV.CvEnum;
 using Emgu.CV.Structure;
+using Kinovea.Video;
 
 namespace Kinovea.ScreenManager
 {
@@ -110,10 +111,10 @@ namespace Kinovea.ScreenManager
                 BitmapData imageData = img.LockBits( new Rectangle( 0, 0, img.Width, img.Height ), ImageLockMode.ReadOnly, img.PixelFormat );
                 BitmapData templateData = tpl.LockBits(new Rectangle( 0, 0, tpl.Width, tpl.Height ), ImageLockMode.ReadOnly, tpl.PixelFormat );
                 
-                Image<Bgra, Byte> cvImage = new Image<Bgra, Byte>(imageData.Width, imageData.Height, imageData.Stride, imageData.Scan0);
-                Image<Bgra, Byte> cvTemplate = new Image<Bgra, Byte>(templateData.Width, templateData.Height, templateData.Stride, templateData.Scan0);
+                CvArray<Byte> cvImage = Tracker.WrapImage(imageData);
+                CvArray<Byte> cvTemplate = Tracker.WrapImage(templateData);
                 
-                cvImage.ROI = searchZone;
+                CvInvoke.cvSetImageROI(cvImage.Ptr, searchZone);
                 
                 int resWidth = searchZone.Width - lastTrackPoint.Template.Width + 1;
                 int resHeight = searchZone.Height - lastTrackPoint.Template.Height + 1;
@@ -195,7 +196,11 @@ namespace Kinovea.ScreenManager
             
             // Copy the template from the image into its own Bitmap.
             
-            Bitmap tpl = new Bitmap(blockWindow.Width, blockWindow.Height, PixelFormat.Format32bppPArgb);
+            PixelFormat format = currentImage != null ? currentImage.PixelFormat : PixelFormat.Format32bppPArgb;
+            Bitmap tpl = new Bitmap(blockWindow.Width, blockWindow.Height, format);
+            if (format == PixelFormat.Format8bppIndexed)
+                tpl.Palette = BitmapHelper.GrayscalePalette;
+
             int age = 0;
             
             bool updateWithCurrentImage = true;
@@ -218,7 +223,7 @@ namespace Kinovea.ScreenManager
                 BitmapData imageData = currentImage.LockBits( new Rectangle( 0, 0, currentImage.Width, currentImage.Height ), ImageLockMode.ReadOnly, currentImage.PixelFormat );
                 BitmapData templateData = tpl.LockBits(new Rectangle( 0, 0, tpl.Width, tpl.Height ), ImageLockMode.ReadWrite, tpl.PixelFormat );
                 
-                int pixelSize = 4;
+                int pixelSize = Image.GetPixelFormatSize(format) / 8;
                 
                 int tplStride = templateData.Stride;
                 int templateWidthInBytes = blockWindow.Width * pixelSize;
@@ -18,5 +18,11 @@ namespace Kinovea.ScreenManager
         internal const int TIME_KILL_SYNCHRONOUS = 0x0100;
 
         internal delegate void TimerCallback(uint uTimerID, uint uMsg, UIntPtr dwUser, UIntPtr dw1, UIntPtr dw2);
+
+        /// <summary>
+        /// TurboJPEG decompression into unmanaged memory. TurboJpegNet only exposes a managed array destination.
+        /// </summary>
+        [DllImport("turbojpeg.dll", CallingConvention = CallingConvention.Cdecl)]
+        internal static extern int tjDecompress2(IntPtr handle, byte[] jpegBuf, uint jpegSize, IntPtr dstBuf, int width, int pitch, int height, int pixelFormat, int flags);
     }
 }
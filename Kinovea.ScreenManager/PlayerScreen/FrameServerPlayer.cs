@@ -22,6 +22,7 @@ using System;
 using System.Collections.Generic;
 using System.ComponentModel;
 using System.Drawing;
+using System.Drawing.Imaging;
 using System.IO;
 using System.Threading;
 using System.Windows.Forms;
@@ -412,7 +413,8 @@ namespace Kinovea.ScreenManager
                     yield break;
                 }
                 
-                Bitmap bmp = vf.Image.CloneDeep();
+                // The drawings are painted on the frame, which can't be done on grayscale indexed frames.
+                Bitmap bmp = vf.Image.CloneDeep(PixelFormat.Format32bppPArgb);
                 long ts = vf.Timestamp;
                 
                 Graphics g = Graphics.FromImage(bmp);
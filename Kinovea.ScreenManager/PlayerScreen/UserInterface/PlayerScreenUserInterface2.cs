@@ -231,6 +231,10 @@ namespace Kinovea.ScreenManager
         
         // Playback current state
         private bool m_bIsCurrentlyPlaying;
+        private bool m_bAsyncSeeking;
+        private bool m_bLoadingWorkingZone;
+        private bool m_bRefineVideoInfoPending;
+        private List<string> m_PendingLinkedAnalyses = new List<string>();
         private int m_iFramesToDecode = 1;
         private uint m_IdMultimediaTimer;
         private PlayingMode m_ePlayingMode = PlayingMode.Loop;
@@ -409,6 +413,9 @@ namespace Kinovea.ScreenManager
             log.Debug("Reset screen to empty state.");
             
             // 1. Reset all data.
+            if (m_FrameServer.VideoReader != null)
+                m_FrameServer.VideoReader.VideoInfoRefined -= VideoReader_VideoInfoRefined;
+
             m_FrameServer.Unload();
             ResetData();
             
@@ -534,6 +541,7 @@ namespace Kinovea.ScreenManager
 
             // Check for launch description and startup kva
             bool recoveredMetadata = false;
+            m_PendingLinkedAnalyses.Clear();
             if (m_LaunchDescription != null)
             {
                 if (m_LaunchDescription.Id != Guid.Empty)
@@ -623,6 +631,79 @@ namespace Kinovea.ScreenManager
             UpdateTimeLabels();
             DoInvalidate();
         }
+        private void VideoReader_VideoInfoRefined(object sender, EventArgs e)
+        {
+            // Raised on the stream analysis thread, possibly while the screen is being closed.
+            if (!IsHandleCreated || IsDisposed)
+                return;
+
+            BeginInvoke((Action)delegate { RefineVideoInfo(); });
+        }
+        private void RefineVideoInfo()
+        {
+            if (!m_FrameServer.Loaded)
+                return;
+
+            // The progress dialog of the cache loading pumps messages, wait for the working zone to be loaded.
+            if (m_bLoadingWorkingZone)
+            {
+                m_bRefineVideoInfoPending = true;
+                return;
+            }
+
+            long oldEnd = m_FrameServer.VideoReader.WorkingZone.End;
+            double oldInterval = m_FrameServer.VideoReader.Info.FrameIntervalMilliseconds;
+            if (m_FrameServer.VideoReader.ApplyVideoInfoRefinement())
+            {
+                AfterVideoInfoRefined(oldEnd, oldInterval);
+
+                // The reader already kept the cache in step with the new duration, only the decoding thread needs the new zone.
+                UpdateWorkingZone(m_FrameServer.VideoReader.DecodingMode != VideoDecodingMode.Caching);
+                UpdateFramesMarkers();
+            }
+
+            if (m_FrameServer.VideoReader.RefiningVideoInfo || m_PendingLinkedAnalyses.Count == 0)
+                return;
+
+            // The timing is final, import the analyses that were waiting for it.
+            StopPlaying();
+            OnPauseAsked();
+
+            List<string> files = new List<string>(m_PendingLinkedAnalyses);
+            m_PendingLinkedAnalyses.Clear();
+            foreach (string file in files)
+                LookForLinkedAnalysis(file);
+
+            m_FrameServer.Metadata.CleanupHash();
+        }
+        private void AfterVideoInfoRefined(long oldEnd, double oldInterval)
+        {
+            log.Debug("Video info refined after load.");
+            VideoInfo info = m_FrameServer.VideoReader.Info;
+            m_iTotalDuration = info.DurationTimeStamps;
+            
+            // Extend or shrink the selection if it was the whole video, otherwise keep it inside the video.
+            if(m_iSelEnd == oldEnd)
+                m_iSelEnd = m_FrameServer.VideoReader.WorkingZone.End;
+            else
+                m_iSelEnd = Math.Min(m_iSelEnd, m_FrameServer.VideoReader.WorkingZone.End);
+
+            m_iSelDuration = m_iSelEnd - m_iSelStart + info.AverageTimeStampsPerFrame;
+            m_FrameServer.Metadata.SelectionEnd = m_iSelEnd;
+            
+            // The metadata was set up with the timing of the quick probe. A custom interval set by the user is kept.
+            if(m_FrameServer.Metadata.UserInterval == oldInterval)
+            {
+                m_FrameServer.Metadata.UserInterval = info.FrameIntervalMilliseconds;
+                m_FrameServer.Metadata.CalibrationHelper.CaptureFramesPerSecond = info.FramesPerSeconds;
+            }
+
+            m_FrameServer.Metadata.AverageTimeStampsPerFrame = info.AverageTimeStampsPerFrame;
+            m_FrameServer.Metadata.FirstTimeStamp = info.FirstTimeStamp;
+            
+            UpdateTimebase();
+            UpdateTimeLabels();
+        }
         public void UpdateTimebase()
         {
             timeMapper.FileInterval = m_FrameServer.VideoReader.Info.FrameIntervalMilliseconds;
@@ -674,9 +755,18 @@ namespace Kinovea.ScreenManager
         }
         private void ProgressWorker(DoWorkEventHandler _doWork)
         {
+            m_bLoadingWorkingZone = true;
             formProgressBar2 fpb = new formProgressBar2(true, false, _doWork);
             fpb.ShowDialog();
             fpb.Dispose();
+            m_bLoadingWorkingZone = false;
+
+            // The working zone is about to be updated by the caller, the refinement must come after.
+            if (m_bRefineVideoInfoPending)
+            {
+                m_bRefineVideoInfoPending = false;
+                BeginInvoke((Action)delegate { RefineVideoInfo(); });
+            }
         }
         public void DisplayAsActiveScreen(bool _bActive)
         {
@@ -903,6 +993,7 @@ namespace Kinovea.ScreenManager
         private void ResetData()
         {
             m_iFramesToDecode = 1;
+            m_bAsyncSeeking = false;
             
             slowMotion = 1;
             DeactivateInteractiveEffect();
@@ -972,11 +1063,18 @@ namespace Kinovea.ScreenManager
         }
         private void LookForLinkedAnalysis(string file)
         {
-            if (File.Exists(file))
+            if (!File.Exists(file))
+                return;
+
+            // Positions in the file are converted with the timing of the video, wait until the reader has refined it.
+            if (m_FrameServer.VideoReader.RefiningVideoInfo)
             {
-                MetadataSerializer s = new MetadataSerializer();
-                s.Load(m_FrameServer.Metadata, file, true);
+                m_PendingLinkedAnalyses.Add(file);
+                return;
             }
+
+            MetadataSerializer s = new MetadataSerializer();
+            s.Load(m_FrameServer.Metadata, file, true);
         }
         private void UpdateFilenameLabel()
         {
@@ -1103,12 +1201,19 @@ namespace Kinovea.ScreenManager
             // This would be a good time to start the prebuffering if supported.
             // The UpdateWorkingZone call may try to go full cache if possible.
             m_FrameServer.VideoReader.PostLoad();
+            
             UpdateWorkingZone(true);
             UpdateFramesMarkers();
             
             ShowHideRenderingSurface(true);
             
             ResizeUpdate(true);
+
+            // The reader may refine the framerate and duration it advertised at load time, this is measured in the background.
+            // The measure may already be over, in which case the event was raised before we listened.
+            m_FrameServer.VideoReader.VideoInfoRefined -= VideoReader_VideoInfoRefined;
+            m_FrameServer.VideoReader.VideoInfoRefined += VideoReader_VideoInfoRefined;
+            RefineVideoInfo();
         }
         #endregion
 
@@ -1804,7 +1909,12 @@ namespace Kinovea.ScreenManager
                 // Update image but do not touch cursor, as the user is manipulating it.
                 // If the position needs to be adjusted to an actual timestamp, it'll be done later.
                 StopPlaying();
-                UpdateFrameCurrentPosition(false);
+                
+                if (m_FrameServer.VideoReader.CanSeekAsync)
+                    SeekAsync(trkFrame.Position);
+                else
+                    UpdateFrameCurrentPosition(false);
+                
                 UpdateCurrentPositionLabel();
                 
                 ActivateKeyframe(m_iCurrentPosition);
@@ -1820,6 +1930,7 @@ namespace Kinovea.ScreenManager
 
                 StopPlaying();
                 OnPauseAsked();
+                EndSeekAsync();
 
                 // Update image and cursor.
                 UpdateFrameCurrentPosition(true);
@@ -1849,6 +1960,53 @@ namespace Kinovea.ScreenManager
             if (m_FrameServer.VideoReader.DecodingMode != VideoDecodingMode.Caching)
                 this.Cursor = Cursors.Default;
         }
+        private void SeekAsync(long target)
+        {
+            // Scrubbing. The frame is shown when the decoding thread has it, newer targets replace pending ones.
+            if (!m_bAsyncSeeking)
+            {
+                m_FrameServer.VideoReader.SeekCompleted -= VideoReader_SeekCompleted;
+                m_FrameServer.VideoReader.SeekCompleted += VideoReader_SeekCompleted;
+                m_bAsyncSeeking = true;
+            }
+
+            m_iCurrentPosition = target;
+            if (m_FrameServer.VideoReader.SeekAsync(target))
+                AfterAsyncSeek();
+        }
+        private void EndSeekAsync()
+        {
+            if (!m_bAsyncSeeking)
+                return;
+
+            m_bAsyncSeeking = false;
+            m_FrameServer.VideoReader.SeekCompleted -= VideoReader_SeekCompleted;
+            m_FrameServer.VideoReader.EndSeekAsync();
+        }
+        private void VideoReader_SeekCompleted(object sender, SeekCompletedEventArgs e)
+        {
+            // Raised on the decoding thread.
+            BeginInvoke((Action)delegate { SeekCompleted_Invoked(); });
+        }
+        private void SeekCompleted_Invoked()
+        {
+            if (!m_bAsyncSeeking || !m_FrameServer.Loaded || !m_FrameServer.VideoReader.ApplyAsyncSeek())
+                return;
+
+            AfterAsyncSeek();
+        }
+        private void AfterAsyncSeek()
+        {
+            if (m_FrameServer.VideoReader.Current == null)
+                return;
+
+            m_iCurrentPosition = m_FrameServer.VideoReader.Current.Timestamp;
+            TrackDrawingsCommand.Execute(null);
+            ComputeOrStopTracking(false);
+            UpdateCurrentPositionLabel();
+            DoInvalidate();
+            ReportForSyncMerge();
+        }
         private void UpdateCurrentPositionLabel()
         {
             // Note: among other places, this is run inside the playloop.
@@ -2113,12 +2271,7 @@ namespace Kinovea.ScreenManager
 
             if(_finished)
             {
-                // Update the decoding size. (May clear and restart the prebuffering).
-                if(m_FrameServer.VideoReader.CanChangeDecodingSize)
-                {
-                    m_FrameServer.VideoReader.ChangeDecodingSize(m_viewportManipulator.DecodingSize);
-                    m_FrameServer.CoordinateSystem.SetRenderingZoomFactor(m_viewportManipulator.RenderingZoomFactor);
-                }
+                UpdateDecodingSize();
                 m_FrameServer.Metadata.ResizeFinished();
                 RefreshImage();
             }
@@ -2127,14 +2280,31 @@ namespace Kinovea.ScreenManager
                 DoInvalidate();
             }
         }
+        private void UpdateDecodingSize()
+        {
+            // Update the decoding size. (May clear and restart the prebuffering).
+            if(!m_FrameServer.VideoReader.CanChangeDecodingSize)
+                return;
+            
+            // When zooming in, only ask for the zoom window, at the size it is rendered.
+            bool region = m_bEnableCustomDecodingSize && m_FrameServer.CoordinateSystem.Zooming && m_FrameServer.VideoReader.CanDecodeRegion;
+            if(region)
+                m_FrameServer.VideoReader.ChangeDecodingRegion(m_FrameServer.CoordinateSystem.ZoomWindow, m_viewportManipulator.RenderingSize);
+            else
+                m_FrameServer.VideoReader.ChangeDecodingSize(m_viewportManipulator.DecodingSize);
+            
+            m_FrameServer.CoordinateSystem.SetRenderingZoomFactor(m_viewportManipulator.RenderingZoomFactor);
+        }
         private void CheckCustomDecodingSize(bool _forceDisable)
         {
             // Enable or disable custom decoding size depending on current state.
             // Custom decoding size is not compatible with tracking.
+            // It is not compatible with the magnifier either, as the magnifier samples the full image and a decoding region only holds the zoom window.
             // The boolean will later be used each time we attempt to change decoding size in StretchSqueezeSurface.
             // This is not concerned with decoding mode (prebuffering, caching, etc.) as this will be checked inside the reader.
             bool wasCustomDecodingSize = m_bEnableCustomDecodingSize;
-            m_bEnableCustomDecodingSize = !m_FrameServer.Metadata.Tracking && !_forceDisable;
+            bool magnifier = m_FrameServer.Metadata.Magnifier.Mode != MagnifierMode.None;
+            m_bEnableCustomDecodingSize = !m_FrameServer.Metadata.Tracking && !magnifier && !_forceDisable;
             
             if(wasCustomDecodingSize && !m_bEnableCustomDecodingSize)
             {
@@ -3000,6 +3170,11 @@ namespace Kinovea.ScreenManager
                 OnPoke();
                 m_FrameServer.Metadata.UpdateTrackPoint(m_FrameServer.CurrentImage);
                 ReportForSyncMerge();
+                
+                // The zoom window may have been moved outside the decoded region.
+                Rectangle region = m_FrameServer.VideoReader.DecodingRegion;
+                if(!region.IsEmpty && region != m_FrameServer.CoordinateSystem.ZoomWindow)
+                    UpdateDecodingSize();
             }
 
             m_FrameServer.Metadata.InitializeCommit(m_FrameServer.VideoReader.Current, m_DescaledMouse);
@@ -3182,7 +3357,11 @@ namespace Kinovea.ScreenManager
             if(m_viewportManipulator.MayDrawUnscaled && m_FrameServer.VideoReader.CanDrawUnscaled)
             {
                 // Source image should be at the right size, unless it has been temporarily disabled.
-                if(m_FrameServer.CoordinateSystem.RenderingZoomWindow.Size.CloseTo(_renderingSize) && !m_FrameServer.Metadata.Mirrored)
+                if(!m_FrameServer.VideoReader.DecodingRegion.IsEmpty)
+                {
+                    DrawDecodingRegion(_sourceImage, g, _renderingSize);
+                }
+                else if(m_FrameServer.CoordinateSystem.RenderingZoomWindow.Size.CloseTo(_renderingSize) && !m_FrameServer.Metadata.Mirrored)
                 {
                     if(!m_FrameServer.CoordinateSystem.Zooming)
                     {
@@ -3251,6 +3430,19 @@ namespace Kinovea.ScreenManager
                 FlushMagnifierOnGraphics(_sourceImage, g, m_FrameServer.CoordinateSystem);
             }
         }
+        private void DrawDecodingRegion(Bitmap _sourceImage, Graphics g, Size _renderingSize)
+        {
+            // The image only covers the region decoded by the reader. Place it relatively to the zoom window.
+            // While the zoom window is being moved, the rest of the surface stays empty until the region is updated.
+            Rectangle rDst = m_FrameServer.CoordinateSystem.Transform(m_FrameServer.VideoReader.DecodingRegion);
+            
+            if(m_FrameServer.Metadata.Mirrored)
+                g.DrawImage(_sourceImage, new Rectangle(_renderingSize.Width - rDst.Left, rDst.Top, -rDst.Width, rDst.Height), new Rectangle(Point.Empty, _sourceImage.Size), GraphicsUnit.Pixel);
+            else if(rDst.Size.CloseTo(_sourceImage.Size))
+                g.DrawImageUnscaled(_sourceImage, rDst.Location);
+            else
+                g.DrawImage(_sourceImage, rDst, new Rectangle(Point.Empty, _sourceImage.Size), GraphicsUnit.Pixel);
+        }
         private void FlushDrawingsOnGraphics(Graphics canvas, CoordinateSystem transformer, int keyFrameIndex, long time)
         {
             DistortionHelper distorter = m_FrameServer.Metadata.CalibrationHelper.DistortionHelper;
@@ -3563,7 +3755,19 @@ namespace Kinovea.ScreenManager
             if (m_FrameServer.CurrentImage == null)
                 return;
 
+            // The thumbnail and the image stored in the keyframe must cover the whole picture, not only the decoding region.
+            bool region = !m_FrameServer.VideoReader.DecodingRegion.IsEmpty;
+            if (region)
+            {
+                CheckCustomDecodingSize(true);
+                m_iFramesToDecode = 1;
+                ShowNextFrame(m_iCurrentPosition, true);
+            }
+
             keyframe.Initialize(m_iCurrentPosition, m_FrameServer.CurrentImage);
+
+            if (region)
+                CheckCustomDecodingSize(false);
         }
         private void DeleteKeyframe(Guid keyframeId)
         {
@@ -3737,6 +3941,7 @@ namespace Kinovea.ScreenManager
             {
                 UnzoomDirectZoom(false);
                 m_FrameServer.Metadata.Magnifier.Mode = MagnifierMode.Direct;
+                CheckCustomDecodingSize(false);
                 SetCursor(Cursors.Cross);
                 
                 if(TrackableDrawingAdded != null)
@@ -3747,6 +3952,7 @@ namespace Kinovea.ScreenManager
                 // Revert to no magnification.
                 UnzoomDirectZoom(false);
                 m_FrameServer.Metadata.Magnifier.Mode = MagnifierMode.None;
+                CheckCustomDecodingSize(false);
                 //btnMagnifier.Image = Drawings.magnifier;
                 SetCursor(m_PointerTool.GetCursor(0));
                 DoInvalidate();
@@ -4232,6 +4438,7 @@ namespace Kinovea.ScreenManager
             // Revert to no magnification.
             m_FrameServer.Metadata.Magnifier.Mode = MagnifierMode.None;
             SetCursor(m_PointerTool.GetCursor(0));
+            CheckCustomDecodingSize(false);
         }
         #endregion
         
@@ -4348,7 +4555,9 @@ namespace Kinovea.ScreenManager
             else
                 rDst = new Rectangle(0, 0, copySize.Width, copySize.Height);
             
-            if(m_viewportManipulator.MayDrawUnscaled && m_FrameServer.VideoReader.CanDrawUnscaled)
+            if(m_viewportManipulator.MayDrawUnscaled && m_FrameServer.VideoReader.CanDrawUnscaled && !m_FrameServer.VideoReader.DecodingRegion.IsEmpty)
+                DrawDecodingRegion(m_FrameServer.CurrentImage, g, copySize);
+            else if(m_viewportManipulator.MayDrawUnscaled && m_FrameServer.VideoReader.CanDrawUnscaled)
                 g.DrawImage(m_FrameServer.CurrentImage, rDst, m_FrameServer.CoordinateSystem.RenderingZoomWindow, GraphicsUnit.Pixel);
             else
                 g.DrawImage(m_FrameServer.CurrentImage, rDst, m_FrameServer.CoordinateSystem.ZoomWindow, GraphicsUnit.Pixel);
@@ -51,11 +51,21 @@ namespace Kinovea.ScreenManager
         private void ProcessSingleImage(Bitmap source)
         {
             ImageStatistics stats = new ImageStatistics(source);
-            LevelsLinear levelsLinear = new LevelsLinear {
-                InRed = stats.Red.GetRange( 0.87 ),
-                InGreen = stats.Green.GetRange( 0.87 ),
-                InBlue  = stats.Blue.GetRange( 0.87 )
-            };
+            LevelsLinear levelsLinear;
+            if(stats.IsGrayscale)
+            {
+                levelsLinear = new LevelsLinear {
+                    InGray = stats.Gray.GetRange( 0.87 )
+                };
+            }
+            else
+            {
+                levelsLinear = new LevelsLinear {
+                    InRed = stats.Red.GetRange( 0.87 ),
+                    InGreen = stats.Green.GetRange( 0.87 ),
+                    InBlue  = stats.Blue.GetRange( 0.87 )
+                };
+            }
             
             levelsLinear.ApplyInPlace(source);
         }
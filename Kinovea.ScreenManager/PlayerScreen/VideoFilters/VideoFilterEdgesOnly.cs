@@ -49,6 +49,13 @@ namespace Kinovea.ScreenManager
         
         private void ProcessSingleImage(Bitmap source)
         {
+            if(source.PixelFormat == PixelFormat.Format8bppIndexed)
+            {
+                // Already gray, and indexed images can't be painted on.
+                filter.ApplyInPlace(source);
+                return;
+            }
+            
             using(Bitmap gray = Grayscale.CommonAlgorithms.BT709.Apply(source))
             using(Bitmap tmp = filter.Apply(gray))
             {
@@ -0,0 +1,161 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Text;
+using System.Diagnostics;
+
+namespace Kinovea.Services
+{
+    /// <summary>
+    /// Histogram of durations with fixed log-linear buckets, in the spirit of HdrHistogram.
+    /// Values are stored in microseconds, each power of two range is split in 32 buckets, giving about 3% precision on any value.
+    /// Recording a value does not allocate and takes a few nanoseconds so the histogram can be left on permanently.
+    /// 
+    /// This class is not thread safe. There must be a single writer thread.
+    /// Reading from another thread gives approximate results, which is good enough for reporting.
+    /// </summary>
+    public class LatencyHistogram : IBenchmarkCounter
+    {
+        public long Count
+        {
+            get { return count; }
+        }
+
+        /// <summary>
+        /// Largest recorded value in microseconds.
+        /// </summary>
+        public long Max
+        {
+            get { return max; }
+        }
+
+        /// <summary>
+        /// Average of the recorded values in microseconds.
+        /// </summary>
+        public double Mean
+        {
+            get { return count == 0 ? 0 : (double)total / count; }
+        }
+
+        private const int subBucketBits = 6;
+        private const int subBucketCount = 1 << subBucketBits;
+        private const int subBucketHalfCount = subBucketCount / 2;
+        private const long maxValue = 60L * 1000 * 1000; // One minute.
+        private static readonly int bucketCount = GetIndex(maxValue) + 1;
+        private static readonly double ticksToMicroseconds = 1000000.0 / Stopwatch.Frequency;
+
+        private long[] counts = new long[bucketCount];
+        private long count;
+        private long total;
+        private long max;
+
+        /// <summary>
+        /// Record a duration expressed in Stopwatch ticks.
+        /// </summary>
+        public void RecordTicks(long ticks)
+        {
+            Record((long)(ticks * ticksToMicroseconds));
+        }
+
+        /// <summary>
+        /// Record a duration expressed in microseconds. Values out of range are clamped.
+        /// </summary>
+        public void Record(long microseconds)
+        {
+            long value = Math.Min(Math.Max(microseconds, 0), maxValue);
+            counts[GetIndex(value)]++;
+            count++;
+            total += value;
+            if (value > max)
+                max = value;
+        }
+
+        /// <summary>
+        /// Returns the value in microseconds below which the given proportion of the recorded values fall.
+        /// </summary>
+        public long GetValueAtPercentile(double percentile)
+        {
+            if (count == 0)
+                return 0;
+
+            long target = Math.Max(1, (long)Math.Ceiling((percentile / 100) * count));
+            long accumulated = 0;
+            for (int i = 0; i < counts.Length; i++)
+            {
+                accumulated += counts[i];
+                if (accumulated >= target)
+                    return Math.Min(GetHighestEquivalentValue(i), max);
+            }
+
+            return max;
+        }
+
+        /// <summary>
+        /// Returns the non empty buckets as pairs of upper bound in microseconds and number of values.
+        /// </summary>
+        public List<KeyValuePair<long, long>> GetBuckets()
+        {
+            List<KeyValuePair<long, long>> buckets = new List<KeyValuePair<long, long>>();
+            for (int i = 0; i < counts.Length; i++)
+            {
+                if (counts[i] > 0)
+                    buckets.Add(new KeyValuePair<long, long>(GetHighestEquivalentValue(i), counts[i]));
+            }
+
+            return buckets;
+        }
+
+        /// <summary>
+        /// Retrieve metrics about the values, in milliseconds.
+        /// </summary>
+        public Dictionary<string, float> GetMetrics()
+        {
+            if (count == 0)
+                return null;
+
+            Dictionary<string, float> metrics = new Dictionary<string, float>();
+            metrics.Add("Count", count);
+            metrics.Add("Average", (float)(Mean / 1000));
+            metrics.Add("Median", GetValueAtPercentile(50) / 1000.0f);
+            metrics.Add("Percentile95", GetValueAtPercentile(95) / 1000.0f);
+            metrics.Add("Percentile99", GetValueAtPercentile(99) / 1000.0f);
+            metrics.Add("Percentile999", GetValueAtPercentile(99.9) / 1000.0f);
+            metrics.Add("Max", max / 1000.0f);
+            return metrics;
+        }
+
+        /// <summary>
+        /// Forget all recorded values. 
+        /// Should be called from the writer thread or while the writer is idle, otherwise a few values may be lost or kept.
+        /// </summary>
+        public void Reset()
+        {
+            Array.Clear(counts, 0, counts.Length);
+            count = 0;
+            total = 0;
+            max = 0;
+        }
+
+        private static int GetIndex(long value)
+        {
+            // Values below subBucketCount are stored exactly.
+            // Above, each doubling of the range goes into the next half-set of buckets with a coarser resolution.
+            int magnitude = 0;
+            while ((value >> magnitude) >= subBucketCount)
+                magnitude++;
+
+            int subBucket = (int)(value >> magnitude);
+            return magnitude == 0 ? subBucket : (magnitude * subBucketHalfCount) + subBucket;
+        }
+
+        private static long GetHighestEquivalentValue(int index)
+        {
+            if (index < subBucketCount)
+                return index;
+
+            int magnitude = (index / subBucketHalfCount) - 1;
+            long subBucket = index - (magnitude * subBucketHalfCount);
+            return ((subBucket + 1) << magnitude) - 1;
+        }
+    }
+}
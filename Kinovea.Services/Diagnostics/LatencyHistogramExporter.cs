@@ -0,0 +1,85 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Text;
+using System.IO;
+using System.Globalization;
+
+namespace Kinovea.Services
+{
+    /// <summary>
+    /// Writes a set of named latency histograms to CSV or JSON.
+    /// All values are in microseconds.
+    /// The CSV has one line per histogram with summary statistics.
+    /// The JSON also contains the non empty buckets to allow re-plotting the distributions.
+    /// </summary>
+    public static class LatencyHistogramExporter
+    {
+        private static readonly double[] percentiles = new double[] { 50, 90, 95, 99, 99.9 };
+
+        public static void ExportCSV(string filename, Dictionary<string, LatencyHistogram> histograms)
+        {
+            using (StreamWriter w = new StreamWriter(filename, false, Encoding.UTF8))
+            {
+                w.WriteLine("Stage;Count;Mean;Median;Percentile90;Percentile95;Percentile99;Percentile999;Max");
+                
+                foreach (var pair in histograms)
+                {
+                    LatencyHistogram h = pair.Value;
+                    StringBuilder b = new StringBuilder();
+                    b.Append(pair.Key.Replace(";", ","));
+                    b.Append(string.Format(CultureInfo.InvariantCulture, ";{0};{1:0.0}", h.Count, h.Mean));
+                    foreach (double percentile in percentiles)
+                        b.Append(string.Format(CultureInfo.InvariantCulture, ";{0}", h.GetValueAtPercentile(percentile)));
+
+                    b.Append(string.Format(CultureInfo.InvariantCulture, ";{0}", h.Max));
+                    w.WriteLine(b.ToString());
+                }
+            }
+        }
+
+        public static void ExportJSON(string filename, Dictionary<string, LatencyHistogram> histograms)
+        {
+            File.WriteAllText(filename, ToJSON(histograms), Encoding.UTF8);
+        }
+
+        public static string ToJSON(Dictionary<string, LatencyHistogram> histograms)
+        {
+            StringBuilder b = new StringBuilder();
+            b.AppendLine("{");
+            b.AppendLine("  \"unit\": \"us\",");
+            b.AppendLine("  \"stages\": [");
+
+            int index = 0;
+            foreach (var pair in histograms)
+            {
+                LatencyHistogram h = pair.Value;
+                b.AppendLine("    {");
+                b.AppendLine(string.Format(CultureInfo.InvariantCulture, "      \"name\": \"{0}\",", Escape(pair.Key)));
+                b.AppendLine(string.Format(CultureInfo.InvariantCulture, "      \"count\": {0},", h.Count));
+                b.AppendLine(string.Format(CultureInfo.InvariantCulture, "      \"mean\": {0:0.0},", h.Mean));
+                b.AppendLine(string.Format(CultureInfo.InvariantCulture, "      \"max\": {0},", h.Max));
+
+                b.Append("      \"percentiles\": {");
+                b.Append(string.Join(", ", percentiles.Select(p => string.Format(CultureInfo.InvariantCulture, "\"{0}\": {1}", p, h.GetValueAtPercentile(p))).ToArray()));
+                b.AppendLine("},");
+
+                b.Append("      \"buckets\": [");
+                b.Append(string.Join(", ", h.GetBuckets().Select(bucket => string.Format(CultureInfo.InvariantCulture, "[{0}, {1}]", bucket.Key, bucket.Value)).ToArray()));
+                b.AppendLine("]");
+
+                index++;
+                b.AppendLine(index < histograms.Count ? "    }," : "    }");
+            }
+
+            b.AppendLine("  ]");
+            b.AppendLine("}");
+            return b.ToString();
+        }
+
+        private static string Escape(string text)
+        {
+            return text.Replace("\\", "\\\\").Replace("\"", "\\\"");
+        }
+    }
+}
@@ -66,6 +66,25 @@ namespace Kinovea.Services
             get { return delayCompositeConfiguration; }
             set { delayCompositeConfiguration = value; }
         }
+
+        /// <summary>
+        /// Record the camera images as is to an AVI file, without any compression.
+        /// For high speed cameras where the encoder cannot keep up.
+        /// </summary>
+        public bool UncompressedRecording
+        {
+            get { return uncompressedRecording; }
+            set { uncompressedRecording = value; }
+        }
+
+        /// <summary>
+        /// Compress uncompressed recordings to MJPEG in the background once the take is over.
+        /// </summary>
+        public bool CompressAfterRecording
+        {
+            get { return compressAfterRecording; }
+            set { compressAfterRecording = value; }
+        }
         #endregion
         
         #region Members
@@ -76,6 +95,8 @@ namespace Kinovea.Services
         private int memoryBuffer = 768;
         private Dictionary<string, CameraBlurb> cameraBlurbs = new Dictionary<string, CameraBlurb>();
         private DelayCompositeConfiguration delayCompositeConfiguration = new DelayCompositeConfiguration();
+        private bool uncompressedRecording = false;
+        private bool compressAfterRecording = true;
         #endregion
         
         public void AddCamera(CameraBlurb blurb)
@@ -104,6 +125,8 @@ namespace Kinovea.Services
             writer.WriteElementString("DisplaySynchronizationFramerate", dsf);
             
             writer.WriteElementString("MemoryBuffer", memoryBuffer.ToString());
+            writer.WriteElementString("UncompressedRecording", uncompressedRecording ? "true" : "false");
+            writer.WriteElementString("CompressAfterRecording", compressAfterRecording ? "true" : "false");
             
             if(cameraBlurbs.Count > 0)
             {
@@ -145,6 +168,12 @@ namespace Kinovea.Services
                     case "MemoryBuffer":
                         memoryBuffer = reader.ReadElementContentAsInt();
                         break;
+                    case "UncompressedRecording":
+                        uncompressedRecording = XmlHelper.ParseBoolean(reader.ReadElementContentAsString());
+                        break;
+                    case "CompressAfterRecording":
+                        compressAfterRecording = XmlHelper.ParseBoolean(reader.ReadElementContentAsString());
+                        break;
                     case "Cameras":
                         ParseCameras(reader);
                         break;
@@ -0,0 +1,134 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Text;
+using System.Diagnostics;
+using System.Threading;
+using Kinovea.Pipeline;
+using Kinovea.Pipeline.Consumers;
+using Kinovea.Pipeline.WaitStrategies;
+
+namespace Kinovea.Tests
+{
+    /// <summary>
+    /// Measure the commit-to-consume latency and the CPU usage of each consumer wait strategy.
+    /// A producer thread commits empty frames at a fixed interval, a single consumer records the time at which it sees each frame.
+    /// The CPU usage is for the whole process, the producer share is the same for all strategies.
+    /// </summary>
+    public class ConsumerWaitStrategies
+    {
+        public static void Test()
+        {
+            int frames = 2000;
+            int intervalMilliseconds = 2;
+
+            TestStrategy("Busy spin", new BusySpinWaitStrategy(), frames, intervalMilliseconds);
+            TestStrategy("Spin then yield", new SpinThenYieldWaitStrategy(), frames, intervalMilliseconds);
+            TestStrategy("Blocking", new BlockingWaitStrategy(), frames, intervalMilliseconds);
+
+            Console.ReadKey();
+        }
+
+        private static void TestStrategy(string name, IWaitStrategy waitStrategy, int frames, int intervalMilliseconds)
+        {
+            RingBuffer ringBuffer = new RingBuffer(8, 16);
+            long[] commitTimes = new long[frames];
+            ConsumerLatency consumer = new ConsumerLatency(commitTimes);
+            consumer.WaitStrategy = waitStrategy;
+
+            Thread consumerThread = new Thread(consumer.Run) { IsBackground = true };
+            consumerThread.Start();
+            while (!consumer.Started)
+                Thread.Sleep(1);
+
+            consumer.SetRingBuffer(ringBuffer);
+            ringBuffer.SetConsumers(new List<IFrameConsumer>() { consumer });
+            consumer.Activate();
+            while (!consumer.Active)
+                Thread.Sleep(1);
+
+            Process process = Process.GetCurrentProcess();
+            TimeSpan cpuStart = process.TotalProcessorTime;
+            Stopwatch sw = Stopwatch.StartNew();
+
+            for (int i = 0; i < frames; i++)
+            {
+                Thread.Sleep(intervalMilliseconds);
+                Commit(ringBuffer, commitTimes, i);
+            }
+
+            double elapsed = (double)sw.ElapsedTicks / Stopwatch.Frequency;
+            process.Refresh();
+            double cpu = (process.TotalProcessorTime - cpuStart).TotalSeconds;
+
+            // Keep the producer going until the consumer notices the deactivation, spinning strategies never time out.
+            consumer.Deactivate();
+            long position = frames;
+            while (consumer.Active)
+            {
+                Commit(ringBuffer, null, position++);
+                Thread.Sleep(1);
+            }
+
+            consumer.Stop();
+            consumerThread.Join();
+
+            double[] latencies = consumer.GetLatencies();
+            Array.Sort(latencies);
+            double average = latencies.Average();
+            double median = latencies[latencies.Length / 2];
+            double p99 = latencies[(int)(latencies.Length * 0.99)];
+            double max = latencies[latencies.Length - 1];
+            double cpuUsage = (cpu / (elapsed * Environment.ProcessorCount)) * 100;
+
+            Console.WriteLine("{0}. Latency (µs), average: {1:0.0}, median: {2:0.0}, 99th percentile: {3:0.0}, max: {4:0.0}. CPU: {5:0.0}% of the machine ({6:0.0}% of a core).",
+                name, average, median, p99, max, cpuUsage, cpuUsage * Environment.ProcessorCount);
+        }
+
+        private static void Commit(RingBuffer ringBuffer, long[] commitTimes, long position)
+        {
+            Frame entry;
+            ringBuffer.TryClaim(out entry);
+            
+            if (commitTimes != null)
+                commitTimes[position] = Stopwatch.GetTimestamp();
+
+            ringBuffer.Commit();
+        }
+
+        /// <summary>
+        /// Records the time elapsed between the commit of each frame and its consumption.
+        /// </summary>
+        private class ConsumerLatency : AbstractConsumer
+        {
+            private long[] commitTimes;
+            private long[] consumeTimes;
+
+            public ConsumerLatency(long[] commitTimes)
+            {
+                this.commitTimes = commitTimes;
+                this.consumeTimes = new long[commitTimes.Length];
+            }
+
+            public double[] GetLatencies()
+            {
+                List<double> latencies = new List<double>();
+                for (int i = 0; i < commitTimes.Length; i++)
+                {
+                    if (consumeTimes[i] == 0)
+                        continue;
+
+                    latencies.Add(((double)(consumeTimes[i] - commitTimes[i]) * 1000000) / Stopwatch.Frequency);
+                }
+
+                return latencies.ToArray();
+            }
+
+            protected override void ProcessEntry(long position, Frame entry)
+            {
+                if (position < consumeTimes.Length)
+                    consumeTimes[position] = Stopwatch.GetTimestamp();
+            }
+        }
+    }
+}
@@ -0,0 +1,335 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Text;
+using System.Diagnostics;
+using System.Globalization;
+using System.IO;
+using System.Threading;
+using Kinovea.Pipeline;
+using Kinovea.Pipeline.Consumers;
+using Kinovea.ScreenManager;
+using Kinovea.Services;
+using Kinovea.Video;
+
+namespace Kinovea.Tests
+{
+    /// <summary>
+    /// Capture pipeline benchmark that runs without camera nor UI, for use in automated runs.
+    /// A synthetic producer feeds the pipeline at the configured size, format and rate, 
+    /// the selected consumers are attached and active for the whole run.
+    /// Reports throughput, drops, per-stage latency percentiles and CPU usage per consumer thread as JSON.
+    /// Consumers are reported under their pipeline name, type and index, so the same consumer type can be attached several times.
+    /// 
+    /// Usage: Kinovea.Tests.exe capture-benchmark [--width 2048] [--height 1084] [--format Y800|RGB24|RGB32] [--fps 100] 
+    /// [--duration 10] [--buffers 8] [--copy] [--consumers Noop,FrameNumber,JPEG,Slow,OccasionallySlow,Recorder] [--output file.json]
+    /// </summary>
+    public class HeadlessCapture
+    {
+        private int width = 2048;
+        private int height = 1084;
+        private ImageFormat format = ImageFormat.Y800;
+        private double framerate = 100;
+        private double duration = 10;
+        private int buffers = 8;
+        private bool copy;
+        private List<string> consumerNames = new List<string>() { "Noop", "Recorder" };
+        private string output;
+
+        private Dictionary<IFrameConsumer, int> consumerThreadIds = new Dictionary<IFrameConsumer, int>();
+
+        public static int Run(string[] args)
+        {
+            HeadlessCapture benchmark = new HeadlessCapture();
+
+            try
+            {
+                benchmark.ParseArguments(args);
+            }
+            catch (Exception e)
+            {
+                Console.Error.WriteLine("Invalid arguments. {0}", e.Message);
+                return 2;
+            }
+
+            return benchmark.Run();
+        }
+
+        /// <summary>
+        /// Short run with the same consumer type attached twice.
+        /// Checks that the run completes and that the report tells the two consumers apart.
+        /// Returns 0 on success.
+        /// </summary>
+        public static int Test()
+        {
+            string report = Path.Combine(Path.GetTempPath(), "capture-benchmark-test.json");
+            HeadlessCapture benchmark = new HeadlessCapture();
+            benchmark.ParseArguments(new string[] { "--width", "640", "--height", "480", "--fps", "100", "--duration", "1", "--consumers", "Noop,Noop", "--output", report });
+
+            int result = benchmark.Run();
+            if (result != 0)
+            {
+                Console.Error.WriteLine("Repeated consumers: the benchmark failed with code {0}.", result);
+                return result;
+            }
+
+            string content = File.ReadAllText(report);
+            File.Delete(report);
+
+            string[] expected = new string[] { "\"ConsumerNoop #0 wait\"", "\"ConsumerNoop #1 wait\"", "\"ConsumerNoop #0\": ", "\"ConsumerNoop #1\": " };
+            foreach (string token in expected)
+            {
+                if (!content.Contains(token))
+                {
+                    Console.Error.WriteLine("Repeated consumers: {0} is missing from the report.", token);
+                    return 1;
+                }
+            }
+
+            Console.WriteLine("Repeated consumers: OK.");
+            return 0;
+        }
+
+        private void ParseArguments(string[] args)
+        {
+            for (int i = 0; i < args.Length; i++)
+            {
+                switch (args[i])
+                {
+                    case "--width": width = int.Parse(args[++i], CultureInfo.InvariantCulture); break;
+                    case "--height": height = int.Parse(args[++i], CultureInfo.InvariantCulture); break;
+                    case "--format": format = (ImageFormat)Enum.Parse(typeof(ImageFormat), args[++i], true); break;
+                    case "--fps": framerate = double.Parse(args[++i], CultureInfo.InvariantCulture); break;
+                    case "--duration": duration = double.Parse(args[++i], CultureInfo.InvariantCulture); break;
+                    case "--buffers": buffers = int.Parse(args[++i], CultureInfo.InvariantCulture); break;
+                    case "--copy": copy = true; break;
+                    case "--consumers": consumerNames = args[++i].Split(new char[] { ',' }, StringSplitOptions.RemoveEmptyEntries).ToList(); break;
+                    case "--output": output = args[++i]; break;
+                    default: throw new ArgumentException(string.Format("Unknown argument: {0}", args[i]));
+                }
+            }
+
+            if (format != ImageFormat.Y800 && format != ImageFormat.RGB24 && format != ImageFormat.RGB32)
+                throw new ArgumentException("Supported formats are Y800, RGB24 and RGB32.");
+        }
+
+        private int Run()
+        {
+            SyntheticProducer producer = new SyntheticProducer(width, height, format, framerate, copy);
+            ImageDescriptor imageDescriptor = producer.ImageDescriptor;
+
+            string recordingFilename = Path.Combine(Path.GetTempPath(), "capture-benchmark.mp4");
+            List<IFrameConsumer> consumers = CreateConsumers(imageDescriptor);
+            if (consumers == null)
+                return 2;
+
+            List<Thread> threads = new List<Thread>();
+            foreach (IFrameConsumer consumer in consumers)
+                threads.Add(StartConsumerThread(consumer));
+
+            FramePipeline pipeline = new FramePipeline(producer, consumers, buffers, imageDescriptor.BufferSize);
+            if (!pipeline.Allocated)
+            {
+                Console.Error.WriteLine("The ring buffer could not be allocated.");
+                return 1;
+            }
+
+            foreach (IFrameConsumer consumer in consumers)
+            {
+                ConsumerMJPEGRecorder recorder = consumer as ConsumerMJPEGRecorder;
+                if (recorder != null)
+                {
+                    SaveResult result = recorder.Prepare(recordingFilename, 1000.0 / framerate);
+                    if (result != SaveResult.Success)
+                    {
+                        Console.Error.WriteLine("The recorder could not be prepared: {0}.", result);
+                        return 1;
+                    }
+                }
+
+                consumer.Activate();
+                while (!consumer.Active)
+                    Thread.Sleep(1);
+            }
+
+            Process process = Process.GetCurrentProcess();
+            Dictionary<IFrameConsumer, TimeSpan> consumerCPUStart = GetConsumerCPU(process);
+            TimeSpan processCPUStart = process.TotalProcessorTime;
+            Stopwatch stopwatch = Stopwatch.StartNew();
+
+            producer.Start();
+            Thread.Sleep(TimeSpan.FromSeconds(duration));
+
+            // Deactivate the consumers while the producer is still running, so they don't wait on it forever.
+            foreach (IFrameConsumer consumer in consumers)
+                consumer.Deactivate();
+
+            foreach (IFrameConsumer consumer in consumers)
+            {
+                while (consumer.Active)
+                    Thread.Sleep(1);
+            }
+
+            producer.Stop();
+            double elapsed = stopwatch.Elapsed.TotalSeconds;
+            process.Refresh();
+            double processCPU = (process.TotalProcessorTime - processCPUStart).TotalSeconds;
+            Dictionary<IFrameConsumer, TimeSpan> consumerCPUEnd = GetConsumerCPU(process);
+
+            string report = CreateReport(producer, pipeline, consumers, elapsed, processCPU, consumerCPUStart, consumerCPUEnd);
+
+            pipeline.Teardown();
+            foreach (IFrameConsumer consumer in consumers)
+                ((AbstractConsumer)consumer).Stop();
+
+            foreach (Thread thread in threads)
+                thread.Join();
+
+            if (File.Exists(recordingFilename))
+                File.Delete(recordingFilename);
+
+            if (string.IsNullOrEmpty(output))
+                Console.WriteLine(report);
+            else
+                File.WriteAllText(output, report, Encoding.UTF8);
+
+            return 0;
+        }
+
+        private List<IFrameConsumer> CreateConsumers(ImageDescriptor imageDescriptor)
+        {
+            List<IFrameConsumer> consumers = new List<IFrameConsumer>();
+            foreach (string name in consumerNames)
+            {
+                switch (name.ToLowerInvariant())
+                {
+                    case "noop":
+                        consumers.Add(new ConsumerNoop());
+                        break;
+                    case "framenumber":
+                        consumers.Add(new ConsumerFrameNumber());
+                        break;
+                    case "jpeg":
+                        // This consumer works on 2048×1084 grayscale images.
+                        if (imageDescriptor.Format != ImageFormat.Y800 || imageDescriptor.BufferSize < 2048 * 1084)
+                        {
+                            Console.Error.WriteLine("The JPEG consumer requires Y800 images of at least 2048×1084.");
+                            return null;
+                        }
+                        consumers.Add(new ConsumerJPEG());
+                        break;
+                    case "slow":
+                        consumers.Add(new ConsumerSlow());
+                        break;
+                    case "occasionallyslow":
+                        consumers.Add(new ConsumerOccasionallySlow());
+                        break;
+                    case "recorder":
+                        ConsumerMJPEGRecorder recorder = new ConsumerMJPEGRecorder();
+                        recorder.SetImageDescriptor(imageDescriptor);
+                        consumers.Add(recorder);
+                        break;
+                    default:
+                        Console.Error.WriteLine("Unknown consumer: {0}.", name);
+                        return null;
+                }
+            }
+
+            return consumers;
+        }
+
+        private Thread StartConsumerThread(IFrameConsumer consumer)
+        {
+            Thread thread = new Thread(() =>
+            {
+                // Keep the OS thread id to read the CPU time of this thread only.
+                #pragma warning disable 618
+                int id = AppDomain.GetCurrentThreadId();
+                #pragma warning restore 618
+                lock (consumerThreadIds)
+                    consumerThreadIds[consumer] = id;
+
+                consumer.Run();
+            });
+
+            thread.IsBackground = true;
+            thread.Name = consumer.GetType().Name;
+            thread.Start();
+
+            while (!consumer.Started)
+                Thread.Sleep(1);
+
+            return thread;
+        }
+
+        private Dictionary<IFrameConsumer, TimeSpan> GetConsumerCPU(Process process)
+        {
+            process.Refresh();
+            Dictionary<IFrameConsumer, TimeSpan> result = new Dictionary<IFrameConsumer, TimeSpan>();
+
+            lock (consumerThreadIds)
+            {
+                foreach (ProcessThread processThread in process.Threads)
+                {
+                    foreach (var pair in consumerThreadIds)
+                    {
+                        if (pair.Value == processThread.Id)
+                            result[pair.Key] = processThread.TotalProcessorTime;
+                    }
+                }
+            }
+
+            return result;
+        }
+
+        private string CreateReport(SyntheticProducer producer, FramePipeline pipeline, List<IFrameConsumer> consumers, double elapsed, double processCPU,
+            Dictionary<IFrameConsumer, TimeSpan> consumerCPUStart, Dictionary<IFrameConsumer, TimeSpan> consumerCPUEnd)
+        {
+            long produced = producer.Produced;
+            long drops = pipeline.Drops;
+
+            StringBuilder b = new StringBuilder();
+            b.AppendLine("{");
+            b.AppendLine("  \"configuration\": {");
+            b.AppendLine(string.Format(CultureInfo.InvariantCulture, "    \"width\": {0},", width));
+            b.AppendLine(string.Format(CultureInfo.InvariantCulture, "    \"height\": {0},", height));
+            b.AppendLine(string.Format(CultureInfo.InvariantCulture, "    \"format\": \"{0}\",", format));
+            b.AppendLine(string.Format(CultureInfo.InvariantCulture, "    \"fps\": {0},", framerate));
+            b.AppendLine(string.Format(CultureInfo.InvariantCulture, "    \"duration\": {0},", duration));
+            b.AppendLine(string.Format(CultureInfo.InvariantCulture, "    \"buffers\": {0},", buffers));
+            b.AppendLine(string.Format(CultureInfo.InvariantCulture, "    \"mode\": \"{0}\",", copy ? "copy" : "in-place"));
+            b.AppendLine(string.Format(CultureInfo.InvariantCulture, "    \"consumers\": [{0}],", string.Join(", ", consumers.Select((c, i) => "\"" + pipeline.GetConsumerName(i) + "\"").ToArray())));
+            b.AppendLine(string.Format(CultureInfo.InvariantCulture, "    \"processors\": {0}", Environment.ProcessorCount));
+            b.AppendLine("  },");
+            b.AppendLine(string.Format(CultureInfo.InvariantCulture, "  \"elapsed\": {0:0.000},", elapsed));
+            b.AppendLine(string.Format(CultureInfo.InvariantCulture, "  \"produced\": {0},", produced));
+            b.AppendLine(string.Format(CultureInfo.InvariantCulture, "  \"drops\": {0},", drops));
+            b.AppendLine(string.Format(CultureInfo.InvariantCulture, "  \"throughput\": {0:0.00},", (produced - drops) / elapsed));
+            b.AppendLine(string.Format(CultureInfo.InvariantCulture, "  \"bandwidth\": {0:0.00},", ((double)(produced - drops) * pipeline.FrameLength / (1024 * 1024)) / elapsed));
+
+            // CPU usage in percent of one core.
+            b.AppendLine("  \"cpu\": {");
+            b.AppendLine(string.Format(CultureInfo.InvariantCulture, "    \"process\": {0:0.0},", (processCPU / elapsed) * 100));
+            b.Append("    \"consumers\": {");
+            List<string> consumerCPU = new List<string>();
+            for (int i = 0; i < consumers.Count; i++)
+            {
+                IFrameConsumer consumer = consumers[i];
+                if (!consumerCPUStart.ContainsKey(consumer) || !consumerCPUEnd.ContainsKey(consumer))
+                    continue;
+
+                double cpu = (consumerCPUEnd[consumer] - consumerCPUStart[consumer]).TotalSeconds;
+                consumerCPU.Add(string.Format(CultureInfo.InvariantCulture, "\"{0}\": {1:0.0}", pipeline.GetConsumerName(i), (cpu / elapsed) * 100));
+            }
+            b.Append(string.Join(", ", consumerCPU.ToArray()));
+            b.AppendLine("}");
+            b.AppendLine("  },");
+
+            b.Append("  \"latency\": ");
+            b.Append(LatencyHistogramExporter.ToJSON(pipeline.GetLatencyHistograms()).TrimEnd());
+            b.AppendLine();
+            b.AppendLine("}");
+            return b.ToString();
+        }
+    }
+}
@@ -6,6 +6,8 @@ using System.Drawing;
 using System.Drawing.Imaging;
 using System.Runtime.InteropServices;
 using System.Diagnostics;
+using Kinovea.Video;
+using Kinovea.Video.FFMpeg;
 
 namespace Kinovea.Tests
 {
@@ -54,6 +56,9 @@ namespace Kinovea.Tests
             //TestCopy3(loops, buffer1, buffer2, length);
             //TestCopy4(1000, buffer1, buffer2, bmp1, bmp2, rect, length);
             TestCopy5(1000, buffer1, buffer2, bmp1, bmp2, rect, length);
+            //TestConversion(1000, size, Video.ImageFormat.Y800);
+            //TestConversion(1000, size, Video.ImageFormat.RGB24);
+            //TestConversion(1000, size, Video.ImageFormat.RGB32);
 
             Console.ReadKey();
         }
@@ -149,6 +154,59 @@ namespace Kinovea.Tests
         }
 
 
+        private static void TestConversion(int loops, Size size, Video.ImageFormat format)
+        {
+            // Camera buffer to RGB24 display bitmap. Managed loops vs native kernels, with and without downscaling.
+            Console.WriteLine("{0} to RGB24, {1}×{2}. Native kernels vectorized: {3}.", format, size.Width, size.Height, PixelConverter.Vectorized);
+
+            byte[] buffer = CreateBuffer(ImageFormatHelper.ComputeBufferSize(size.Width, size.Height, format));
+            Rectangle rect = new Rectangle(0, 0, size.Width, size.Height);
+            Bitmap bmp = new Bitmap(size.Width, size.Height, PixelFormat.Format24bppRgb);
+
+            Stopwatch sw = Stopwatch.StartNew();
+            for (int i = 0; i < loops; i++)
+            {
+                switch (format)
+                {
+                    case Video.ImageFormat.Y800: BitmapHelper.FillFromY800(bmp, rect, true, buffer); break;
+                    case Video.ImageFormat.RGB24: BitmapHelper.FillFromRGB24(bmp, rect, true, buffer); break;
+                    case Video.ImageFormat.RGB32: BitmapHelper.FillFromRGB32(bmp, rect, true, buffer); break;
+                }
+            }
+
+            PrintConversion("BitmapHelper", sw, loops);
+
+            foreach (int downscale in new int[] { 1, 2, 4 })
+            {
+                Bitmap target = downscale == 1 ? bmp : new Bitmap(size.Width / downscale, size.Height / downscale, PixelFormat.Format24bppRgb);
+
+                sw = Stopwatch.StartNew();
+                for (int i = 0; i < loops; i++)
+                {
+                    switch (format)
+                    {
+                        case Video.ImageFormat.Y800: PixelConverter.FillFromY800(target, size, true, buffer, downscale); break;
+                        case Video.ImageFormat.RGB24: PixelConverter.FillFromRGB24(target, size, true, buffer, downscale); break;
+                        case Video.ImageFormat.RGB32: PixelConverter.FillFromRGB32(target, size, true, buffer, downscale); break;
+                    }
+                }
+
+                PrintConversion(string.Format("PixelConverter 1/{0}", downscale), sw, loops);
+
+                if (target != bmp)
+                    target.Dispose();
+            }
+
+            bmp.Dispose();
+        }
+
+        private static void PrintConversion(string name, Stopwatch sw, int loops)
+        {
+            double elapsed = (double)sw.ElapsedTicks / Stopwatch.Frequency;
+            double averageMilliseconds = (elapsed * 1000) / loops;
+            Console.WriteLine("{0}: average conversion time ({1} loops): {2:0.000} ms.", name, loops, averageMilliseconds);
+        }
+
         private static byte[] CreateBuffer(int size)
         {
             byte[] buffer = new byte[size];
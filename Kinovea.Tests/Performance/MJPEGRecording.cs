@@ -0,0 +1,98 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Text;
+using System.Drawing;
+using System.Diagnostics;
+using System.IO;
+using Kinovea.Video;
+using Kinovea.Video.FFMpeg;
+
+namespace Kinovea.Tests
+{
+    /// <summary>
+    /// Measure the cost of recording camera frames with the MJPEG writer.
+    /// Wall time and CPU time per frame are reported for each input format, with a single encoder and with parallel encoders.
+    /// </summary>
+    public class MJPEGRecording
+    {
+        public static void Test()
+        {
+            // Emulate a machine vision camera.
+            Size size = new Size(2048, 1084);
+            int frames = 1000;
+            double interval = 1000.0 / 30;
+            string filename = Path.Combine(Path.GetTempPath(), "mjpeg-recording-benchmark.avi");
+
+            int encoders = Math.Max(2, Environment.ProcessorCount - 2);
+
+            TestFormat(ImageFormat.Y800, size, frames, interval, filename, 1);
+            TestFormat(ImageFormat.Y800, size, frames, interval, filename, encoders);
+            TestFormat(ImageFormat.RGB24, size, frames, interval, filename, 1);
+            TestFormat(ImageFormat.RGB24, size, frames, interval, filename, encoders);
+            TestFormat(ImageFormat.RGB32, size, frames, interval, filename, 1);
+            TestFormat(ImageFormat.RGB32, size, frames, interval, filename, encoders);
+
+            Console.ReadKey();
+        }
+
+        private static void TestFormat(ImageFormat format, Size size, int frames, double interval, string filename, int encoders)
+        {
+            int bufferSize = ImageFormatHelper.ComputeBufferSize(size.Width, size.Height, format);
+            byte[] buffer = CreateBuffer(size, bufferSize);
+
+            VideoInfo info = new VideoInfo();
+            info.OriginalSize = size;
+
+            MJPEGWriter writer = new MJPEGWriter();
+            SaveResult result = writer.OpenSavingContext(filename, info, "avi", format, interval, encoders);
+            if (result != SaveResult.Success)
+            {
+                Console.WriteLine("{0}: saving context could not be opened: {1}.", format, result);
+                writer.Dispose();
+                return;
+            }
+
+            Process process = Process.GetCurrentProcess();
+            TimeSpan cpuStart = process.TotalProcessorTime;
+            Stopwatch sw = Stopwatch.StartNew();
+            
+            for (int i = 0; i < frames; i++)
+                writer.SaveFrame(format, buffer, bufferSize);
+
+            // Closing waits for the frames still in the encoders.
+            writer.CloseSavingContext(true);
+            
+            double elapsed = (double)sw.ElapsedTicks / Stopwatch.Frequency;
+            process.Refresh();
+            double cpu = (process.TotalProcessorTime - cpuStart).TotalSeconds;
+
+            writer.Dispose();
+
+            long fileSize = new FileInfo(filename).Length;
+            File.Delete(filename);
+
+            double averageMilliseconds = (elapsed * 1000) / frames;
+            double averageCPUMilliseconds = (cpu * 1000) / frames;
+            float megabytes = (float)fileSize / (1024 * 1024);
+            Console.WriteLine("{0} {1}×{2}, {3} encoder(s). Average time per frame ({4} frames): {5:0.000} ms. CPU time per frame: {6:0.000} ms. File: {7:0.00} MB.", 
+                format, size.Width, size.Height, encoders, frames, averageMilliseconds, averageCPUMilliseconds, megabytes);
+        }
+
+        private static byte[] CreateBuffer(Size size, int bufferSize)
+        {
+            // Smooth gradient. Random bytes would not be representative of camera images and
+            // could produce JPEG samples larger than the uncompressed frame.
+            byte[] buffer = new byte[bufferSize];
+            int stride = bufferSize / size.Height;
+            for (int i = 0; i < buffer.Length; i++)
+            {
+                int x = i % stride;
+                int y = i / stride;
+                buffer[i] = (byte)((x + y) / 8);
+            }
+
+            return buffer;
+        }
+    }
+}
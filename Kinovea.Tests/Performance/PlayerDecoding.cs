@@ -0,0 +1,432 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Text;
+using System.Diagnostics;
+using System.Drawing;
+using System.Globalization;
+using System.IO;
+using System.Threading;
+using Kinovea.Services;
+using Kinovea.Video;
+using Kinovea.Video.FFMpeg;
+
+namespace Kinovea.Tests
+{
+    /// <summary>
+    /// Decoding benchmark for the player.
+    /// Generates synthetic clips for each combination of encoder, size, GOP length and B-frames, 
+    /// then measures the decoding paths of VideoReaderFFMpeg on each clip:
+    /// open, time to first frame, sequential decoding, random seeks, single step forward, single step backward and summary extraction.
+    /// The reader is used in on-demand mode (no prebuffering) so the numbers are those of ReadFrame and SeekTo.
+    /// Each decoded frame carries its frame number, which is read back to count the seeks that landed on the wrong frame.
+    /// With --trace, the decode trace of each clip is exported in Chrome trace format to the given directory.
+    ///
+    /// Usage: Kinovea.Tests.exe decode-benchmark [--encoders mpeg4,mjpeg,libx264] [--sizes 640x360,1280x720,1920x1080] 
+    /// [--gops 0,12,250] [--bframes 0,2] [--frames 300] [--fps 30] [--seeks 50] [--directory dir] [--keep] [--trace dir] [--output file.json]
+    /// </summary>
+    public class PlayerDecoding
+    {
+        private List<string> encoders = new List<string>() { "mpeg4", "mjpeg", "libx264" };
+        private List<Size> sizes = new List<Size>() { new Size(640, 360), new Size(1280, 720), new Size(1920, 1080) };
+        private List<int> gops = new List<int>() { 0, 12, 250 };
+        private List<int> bframes = new List<int>() { 0, 2 };
+        private int frames = 300;
+        private int framerate = 30;
+        private int seeks = 50;
+        private int summaryRuns = 5;
+        private int summaryThumbs = 5;
+        private Size summarySize = new Size(200, 150);
+        private string directory = Path.Combine(Path.GetTempPath(), "decode-benchmark");
+        private bool keep;
+        private string traceDirectory;
+        private string output;
+
+        public static int Run(string[] args)
+        {
+            PlayerDecoding benchmark = new PlayerDecoding();
+
+            try
+            {
+                benchmark.ParseArguments(args);
+            }
+            catch (Exception e)
+            {
+                Console.Error.WriteLine("Invalid arguments. {0}", e.Message);
+                return 2;
+            }
+
+            return benchmark.Run();
+        }
+
+        /// <summary>
+        /// Checks that stepping forward lands on the next frame right after backward fills of the prebuffer.
+        /// A backward fill may drop frames at the end of the prebuffer, the step must then continue after the last frame kept.
+        ///
+        /// Usage: Kinovea.Tests.exe decode-prebuffer-test
+        /// </summary>
+        public static int TestStepAfterBackwardFill()
+        {
+            PlayerDecoding test = new PlayerDecoding();
+            Size size = new Size(640, 360);
+            string filename = Path.Combine(test.directory, "prebuffer-test.mp4");
+            Directory.CreateDirectory(test.directory);
+
+            if (!SyntheticClipGenerator.Generate(filename, "mpeg4", size, test.frames, test.framerate, 12, 0))
+            {
+                Console.Error.WriteLine("Step after backward fill: clip not generated.");
+                return 1;
+            }
+
+            int errors = 0;
+            VideoReaderFFMpeg reader = new VideoReaderFFMpeg();
+            reader.Options = VideoOptions.Default;
+
+            try
+            {
+                if (reader.Open(filename) != OpenVideoResult.Success)
+                {
+                    Console.Error.WriteLine("Step after backward fill: clip not opened.");
+                    return 1;
+                }
+
+                // Like the player: first frame on demand, then prebuffering.
+                reader.MoveNext(0, true);
+                reader.PostLoad();
+                if (reader.DecodingMode != VideoDecodingMode.PreBuffering)
+                {
+                    Console.Error.WriteLine("Step after backward fill: the reader is not prebuffering.");
+                    return 1;
+                }
+
+                VideoInfo info = reader.Info;
+                int frameCount = (int)(info.DurationTimeStamps / info.AverageTimeStampsPerFrame);
+
+                // Land in the middle and let the decoding thread fill the prebuffer ahead of the play head.
+                int position = frameCount / 2;
+                reader.MoveTo(Timestamp(info, position));
+                Thread.Sleep(500);
+
+                // Step backwards so the decoding thread fills before the segment, dropping frames at its end to make room.
+                for (int i = 0; i < 60 && position > 0; i++)
+                {
+                    reader.MovePrev();
+                    position--;
+                    Thread.Sleep(10);
+                    if (FrameNumber(reader, size) != position)
+                        errors++;
+                }
+
+                // Step forward through the segment and past its end.
+                while (position < frameCount - 1)
+                {
+                    reader.MoveNext(0, true);
+                    position++;
+                    if (FrameNumber(reader, size) != position)
+                        errors++;
+                }
+            }
+            finally
+            {
+                reader.Close();
+                if (File.Exists(filename))
+                    File.Delete(filename);
+            }
+
+            if (errors > 0)
+            {
+                Console.Error.WriteLine("Step after backward fill: {0} steps landed on the wrong frame.", errors);
+                return 1;
+            }
+
+            Console.WriteLine("Step after backward fill: OK.");
+            return 0;
+        }
+
+        private void ParseArguments(string[] args)
+        {
+            for (int i = 0; i < args.Length; i++)
+            {
+                switch (args[i])
+                {
+                    case "--encoders": encoders = Split(args[++i]).ToList(); break;
+                    case "--sizes": sizes = Split(args[++i]).Select(s => ParseSize(s)).ToList(); break;
+                    case "--gops": gops = Split(args[++i]).Select(s => int.Parse(s, CultureInfo.InvariantCulture)).ToList(); break;
+                    case "--bframes": bframes = Split(args[++i]).Select(s => int.Parse(s, CultureInfo.InvariantCulture)).ToList(); break;
+                    case "--frames": frames = int.Parse(args[++i], CultureInfo.InvariantCulture); break;
+                    case "--fps": framerate = int.Parse(args[++i], CultureInfo.InvariantCulture); break;
+                    case "--seeks": seeks = int.Parse(args[++i], CultureInfo.InvariantCulture); break;
+                    case "--directory": directory = args[++i]; break;
+                    case "--keep": keep = true; break;
+                    case "--trace": traceDirectory = args[++i]; break;
+                    case "--output": output = args[++i]; break;
+                    default: throw new ArgumentException(string.Format("Unknown argument: {0}", args[i]));
+                }
+            }
+
+            // Below this the reader switches to caching mode and the decoder is no longer exercised.
+            if (frames <= 50)
+                throw new ArgumentException("The clips must have more than 50 frames.");
+
+            // Frame numbers are stamped on 16 bits, longer clips would be misattributed.
+            if (frames > SyntheticClipGenerator.MaxFrames)
+                throw new ArgumentException(string.Format("The clips must have at most {0} frames.", SyntheticClipGenerator.MaxFrames));
+
+            if (sizes.Any(s => s.Width < SyntheticClipGenerator.MinWidth))
+                throw new ArgumentException(string.Format("The clips must be at least {0} pixels wide.", SyntheticClipGenerator.MinWidth));
+        }
+
+        private static string[] Split(string value)
+        {
+            return value.Split(new char[] { ',' }, StringSplitOptions.RemoveEmptyEntries);
+        }
+
+        private static Size ParseSize(string value)
+        {
+            string[] parts = value.Split('x');
+            return new Size(int.Parse(parts[0], CultureInfo.InvariantCulture), int.Parse(parts[1], CultureInfo.InvariantCulture));
+        }
+
+        private int Run()
+        {
+            Directory.CreateDirectory(directory);
+            if (!string.IsNullOrEmpty(traceDirectory))
+                Directory.CreateDirectory(traceDirectory);
+
+            List<string> results = new List<string>();
+
+            foreach (string encoder in encoders)
+            {
+                if (!SyntheticClipGenerator.IsEncoderAvailable(encoder))
+                {
+                    Console.Error.WriteLine("Encoder not available, skipped: {0}.", encoder);
+                    continue;
+                }
+
+                bool intraOnly = encoder == "mjpeg";
+                foreach (Size size in sizes)
+                {
+                    foreach (int gop in intraOnly ? new List<int>() { 0 } : gops)
+                    {
+                        foreach (int maxBFrames in (intraOnly || gop == 0) ? new List<int>() { 0 } : bframes)
+                        {
+                            string result = RunClip(encoder, size, gop, maxBFrames);
+                            if (result != null)
+                                results.Add(result);
+                        }
+                    }
+                }
+            }
+
+            StringBuilder report = new StringBuilder();
+            report.AppendLine("{");
+            report.AppendLine(string.Format(CultureInfo.InvariantCulture, "  \"frames\": {0},", frames));
+            report.AppendLine(string.Format(CultureInfo.InvariantCulture, "  \"fps\": {0},", framerate));
+            report.AppendLine(string.Format(CultureInfo.InvariantCulture, "  \"processors\": {0},", Environment.ProcessorCount));
+            report.AppendLine("  \"clips\": [");
+            report.Append(string.Join(",\n", results.ToArray()));
+            report.AppendLine();
+            report.AppendLine("  ]");
+            report.AppendLine("}");
+
+            if (string.IsNullOrEmpty(output))
+                Console.WriteLine(report.ToString());
+            else
+                File.WriteAllText(output, report.ToString(), Encoding.UTF8);
+
+            return 0;
+        }
+
+        private string RunClip(string encoder, Size size, int gop, int maxBFrames)
+        {
+            string extension = encoder == "mjpeg" ? ".avi" : ".mp4";
+            string name = string.Format(CultureInfo.InvariantCulture, "{0}-{1}x{2}-gop{3}-b{4}", encoder, size.Width, size.Height, gop, maxBFrames);
+            string filename = Path.Combine(directory, name + extension);
+            Console.Error.WriteLine("{0}...", name);
+
+            if (!SyntheticClipGenerator.Generate(filename, encoder, size, frames, framerate, gop, maxBFrames))
+            {
+                Console.Error.WriteLine("Clip not generated: {0}.", name);
+                return null;
+            }
+
+            string result = null;
+            try
+            {
+                result = Measure(name, filename, encoder, size, gop, maxBFrames);
+            }
+            catch (Exception e)
+            {
+                Console.Error.WriteLine("Error while measuring {0}. {1}", name, e.Message);
+            }
+
+            if (!keep && File.Exists(filename))
+                File.Delete(filename);
+
+            return result;
+        }
+
+        private string Measure(string name, string filename, string encoder, Size size, int gop, int maxBFrames)
+        {
+            Random random = new Random(0);
+            Stopwatch stopwatch = new Stopwatch();
+
+            VideoReaderFFMpeg reader = new VideoReaderFFMpeg();
+            reader.Options = VideoOptions.Default;
+            reader.Trace.Enabled = !string.IsNullOrEmpty(traceDirectory);
+
+            try
+            {
+                stopwatch.Start();
+                OpenVideoResult opened = reader.Open(filename);
+                double openTime = stopwatch.Elapsed.TotalMilliseconds;
+                if (opened != OpenVideoResult.Success)
+                {
+                    Console.Error.WriteLine("Clip not opened: {0}, {1}.", name, opened);
+                    return null;
+                }
+
+                // Time to first frame, from the start of the open, like the player showing the first image.
+                reader.MoveNext(0, true);
+                double firstFrameTime = stopwatch.Elapsed.TotalMilliseconds;
+
+                VideoInfo info = reader.Info;
+                int frameCount = (int)(info.DurationTimeStamps / info.AverageTimeStampsPerFrame);
+
+                // Sequential decoding from the start.
+                int decoded = 0;
+                int sequentialErrors = 0;
+                reader.MoveTo(info.FirstTimeStamp);
+                stopwatch.Reset();
+                stopwatch.Start();
+                while (decoded < frameCount - 1 && reader.MoveNext(0, true))
+                    decoded++;
+                double sequentialTime = stopwatch.Elapsed.TotalSeconds;
+
+                // Separate pass for accuracy so reading pixels doesn't count in the decoding time.
+                reader.MoveTo(info.FirstTimeStamp);
+                for (int i = 1; i <= decoded; i++)
+                {
+                    reader.MoveNext(0, true);
+                    if (FrameNumber(reader, size) != i)
+                        sequentialErrors++;
+                }
+
+                // Random seeks.
+                LatencyHistogram seekLatency = new LatencyHistogram();
+                int seekErrors = 0;
+                for (int i = 0; i < seeks; i++)
+                {
+                    int target = random.Next(frameCount);
+                    long start = Stopwatch.GetTimestamp();
+                    reader.MoveTo(Timestamp(info, target));
+                    seekLatency.RecordTicks(Stopwatch.GetTimestamp() - start);
+
+                    if (FrameNumber(reader, size) != target)
+                        seekErrors++;
+                }
+
+                // Single step forward from a random position.
+                LatencyHistogram forwardLatency = new LatencyHistogram();
+                int forwardErrors = 0;
+                for (int i = 0; i < seeks; i++)
+                {
+                    int target = random.Next(frameCount - 2);
+                    reader.MoveTo(Timestamp(info, target));
+
+                    long start = Stopwatch.GetTimestamp();
+                    reader.MoveNext(0, true);
+                    forwardLatency.RecordTicks(Stopwatch.GetTimestamp() - start);
+
+                    if (FrameNumber(reader, size) != target + 1)
+                        forwardErrors++;
+                }
+
+                // Single step backward from a random position. The player does this with a seek to the previous timestamp.
+                LatencyHistogram backwardLatency = new LatencyHistogram();
+                int backwardErrors = 0;
+                for (int i = 0; i < seeks; i++)
+                {
+                    int target = 1 + random.Next(frameCount - 2);
+                    reader.MoveTo(Timestamp(info, target));
+
+                    long start = Stopwatch.GetTimestamp();
+                    reader.MoveTo(Timestamp(info, target - 1));
+                    backwardLatency.RecordTicks(Stopwatch.GetTimestamp() - start);
+
+                    if (FrameNumber(reader, size) != target - 1)
+                        backwardErrors++;
+                }
+
+                if (reader.Trace.Enabled)
+                    reader.Trace.ExportChromeTrace(Path.Combine(traceDirectory, name + ".trace.json"));
+
+                // Closed before the summaries so they run alone. The second close in the finally does nothing.
+                reader.Close();
+
+                // Summary extraction, with a new reader each time like the file explorer.
+                LatencyHistogram summaryLatency = new LatencyHistogram();
+                for (int i = 0; i < summaryRuns; i++)
+                {
+                    VideoReaderFFMpeg summaryReader = new VideoReaderFFMpeg();
+                    summaryReader.Options = VideoOptions.Default;
+
+                    long start = Stopwatch.GetTimestamp();
+                    VideoSummary summary = summaryReader.ExtractSummary(filename, summaryThumbs, summarySize);
+                    summaryLatency.RecordTicks(Stopwatch.GetTimestamp() - start);
+
+                    foreach (Bitmap thumb in summary.Thumbs)
+                        thumb.Dispose();
+                }
+
+                StringBuilder b = new StringBuilder();
+                b.AppendLine("    {");
+                b.AppendLine(string.Format(CultureInfo.InvariantCulture, "      \"name\": \"{0}\",", name));
+                b.AppendLine(string.Format(CultureInfo.InvariantCulture, "      \"encoder\": \"{0}\",", encoder));
+                b.AppendLine(string.Format(CultureInfo.InvariantCulture, "      \"width\": {0},", size.Width));
+                b.AppendLine(string.Format(CultureInfo.InvariantCulture, "      \"height\": {0},", size.Height));
+                b.AppendLine(string.Format(CultureInfo.InvariantCulture, "      \"gop\": {0},", gop));
+                b.AppendLine(string.Format(CultureInfo.InvariantCulture, "      \"bframes\": {0},", maxBFrames));
+                b.AppendLine(string.Format(CultureInfo.InvariantCulture, "      \"fileSize\": {0},", new FileInfo(filename).Length));
+                b.AppendLine(string.Format(CultureInfo.InvariantCulture, "      \"open\": {0:0.000},", openTime));
+                b.AppendLine(string.Format(CultureInfo.InvariantCulture, "      \"firstFrame\": {0:0.000},", firstFrameTime));
+                b.AppendLine("      \"sequential\": {");
+                b.AppendLine(string.Format(CultureInfo.InvariantCulture, "        \"frames\": {0},", decoded));
+                b.AppendLine(string.Format(CultureInfo.InvariantCulture, "        \"fps\": {0:0.00},", decoded / sequentialTime));
+                b.AppendLine(string.Format(CultureInfo.InvariantCulture, "        \"errors\": {0}", sequentialErrors));
+                b.AppendLine("      },");
+                b.AppendLine(FormatLatency("seek", seekLatency, seekErrors) + ",");
+                b.AppendLine(FormatLatency("stepForward", forwardLatency, forwardErrors) + ",");
+                b.AppendLine(FormatLatency("stepBackward", backwardLatency, backwardErrors) + ",");
+                b.AppendLine(FormatLatency("summary", summaryLatency, 0));
+                b.Append("    }");
+                return b.ToString();
+            }
+            finally
+            {
+                reader.Close();
+            }
+        }
+
+        private static long Timestamp(VideoInfo info, int frame)
+        {
+            return info.FirstTimeStamp + (frame * info.AverageTimeStampsPerFrame);
+        }
+
+        private static int FrameNumber(VideoReaderFFMpeg reader, Size size)
+        {
+            return reader.Current == null ? -1 : SyntheticClipGenerator.ReadFrameNumber(reader.Current.Image, size);
+        }
+
+        /// <summary>
+        /// Latencies in milliseconds.
+        /// </summary>
+        private static string FormatLatency(string name, LatencyHistogram histogram, int errors)
+        {
+            return string.Format(CultureInfo.InvariantCulture,
+                "      \"{0}\": {{ \"count\": {1}, \"mean\": {2:0.000}, \"p50\": {3:0.000}, \"p90\": {4:0.000}, \"p99\": {5:0.000}, \"max\": {6:0.000}, \"errors\": {7} }}",
+                name, histogram.Count, histogram.Mean / 1000, histogram.GetValueAtPercentile(50) / 1000.0, histogram.GetValueAtPercentile(90) / 1000.0, 
+                histogram.GetValueAtPercentile(99) / 1000.0, histogram.Max / 1000.0, errors);
+        }
+    }
+}
@@ -0,0 +1,180 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Text;
+using System.Diagnostics;
+using System.Threading;
+using Kinovea.Pipeline;
+using Kinovea.Video;
+using Kinovea.Camera.FrameGenerator;
+
+namespace Kinovea.Tests
+{
+    /// <summary>
+    /// Frame producer for headless benchmarks, standing in for a camera.
+    /// Produces frames of the configured size and format at a fixed rate on its own thread.
+    /// 
+    /// Frames start from a gradient image. RGB24 frames get the timestamp of the frame generator camera baked in,
+    /// other formats get the frame number in the first bytes.
+    /// By default frames are written in place in the pipeline slots, in copy mode they are raised for the pipeline to copy.
+    /// </summary>
+    public class SyntheticProducer : IFrameSlotProducer
+    {
+        public event EventHandler<FrameProducedEventArgs> FrameProduced;
+
+        public ImageDescriptor ImageDescriptor
+        {
+            get { return imageDescriptor; }
+        }
+
+        public long Produced
+        {
+            get { return produced; }
+        }
+
+        private ImageDescriptor imageDescriptor;
+        private double frameIntervalMilliseconds;
+        private bool copy;
+        private Generator generator;
+        private byte[] template;
+        private byte[] frameBuffer;
+        private Dictionary<Frame, bool> initializedSlots = new Dictionary<Frame, bool>();
+        private volatile FramePipeline pipeline;
+        private volatile bool stopAsked;
+        private Thread thread;
+        private long produced;
+
+        public SyntheticProducer(int width, int height, ImageFormat format, double framerate, bool copy)
+        {
+            int bufferSize = ImageFormatHelper.ComputeBufferSize(width, height, format);
+            imageDescriptor = new ImageDescriptor(format, width, height, true, bufferSize);
+            frameIntervalMilliseconds = 1000.0 / framerate;
+            this.copy = copy;
+
+            if (format == ImageFormat.RGB24)
+                generator = new Generator(new DeviceConfiguration(width, height, (int)(frameIntervalMilliseconds * 1000), format));
+
+            template = CreateTemplate(width, height, bufferSize);
+            frameBuffer = new byte[bufferSize];
+            Buffer.BlockCopy(template, 0, frameBuffer, 0, bufferSize);
+        }
+
+        public void SetPipeline(FramePipeline pipeline)
+        {
+            if (!copy)
+                this.pipeline = pipeline;
+        }
+
+        public void ClearPipeline()
+        {
+            this.pipeline = null;
+        }
+
+        public void Start()
+        {
+            stopAsked = false;
+            thread = new Thread(Run) { IsBackground = true };
+            thread.Name = "Grabber - Synthetic";
+            thread.Start();
+        }
+
+        public void Stop()
+        {
+            stopAsked = true;
+            if (thread != null)
+                thread.Join();
+        }
+
+        private void Run()
+        {
+            Stopwatch stopwatch = Stopwatch.StartNew();
+
+            while (!stopAsked)
+            {
+                // Sleep while the next frame is far, then yield.
+                // The due time is absolute so a late frame is followed by a short burst, as with a real camera buffer.
+                double dueTime = (produced + 1) * frameIntervalMilliseconds;
+                double remaining = dueTime - stopwatch.Elapsed.TotalMilliseconds;
+                if (remaining > 2)
+                {
+                    Thread.Sleep(1);
+                    continue;
+                }
+                else if (remaining > 0)
+                {
+                    Thread.Sleep(0);
+                    continue;
+                }
+
+                produced++;
+
+                FramePipeline pipeline = this.pipeline;
+                if (pipeline != null)
+                    ProduceInPlace(pipeline);
+                else
+                    ProduceCopy();
+            }
+        }
+
+        private void ProduceInPlace(FramePipeline pipeline)
+        {
+            Frame entry;
+            int length = 0;
+
+            if (pipeline.TryClaimSlot(out entry))
+            {
+                if (!initializedSlots.ContainsKey(entry))
+                {
+                    Buffer.BlockCopy(template, 0, entry.Buffer, 0, template.Length);
+                    initializedSlots.Add(entry, true);
+                }
+
+                Stamp(entry.Buffer);
+                length = imageDescriptor.BufferSize;
+                pipeline.CommitSlot(entry, length);
+            }
+
+            if (FrameProduced != null)
+                FrameProduced(this, new FrameProducedEventArgs(entry == null ? null : entry.Buffer, length, true));
+        }
+
+        private void ProduceCopy()
+        {
+            Stamp(frameBuffer);
+
+            if (FrameProduced != null)
+                FrameProduced(this, new FrameProducedEventArgs(frameBuffer, frameBuffer.Length));
+        }
+
+        private void Stamp(byte[] buffer)
+        {
+            if (generator != null)
+            {
+                generator.Generate(buffer);
+                return;
+            }
+
+            long value = produced;
+            for (int i = 0; i < 8; i++)
+            {
+                buffer[i] = (byte)(value & 0xFF);
+                value >>= 8;
+            }
+        }
+
+        private static byte[] CreateTemplate(int width, int height, int bufferSize)
+        {
+            // Smooth gradient, so that encoders see something closer to a camera image than random noise or a flat color.
+            byte[] buffer = new byte[bufferSize];
+            int stride = bufferSize / height;
+            for (int i = 0; i < buffer.Length; i++)
+            {
+                int x = i % stride;
+                int y = i / stride;
+                buffer[i] = (byte)((x + y) / 8);
+            }
+
+            return buffer;
+        }
+    }
+}
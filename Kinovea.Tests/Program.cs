@@ -12,6 +12,31 @@ namespace Kinovea.Tests
     {
         public static void Main(string[] args)
         {
+            // Headless benchmarks runnable from scripts.
+            if (args.Length > 0 && args[0] == "capture-benchmark")
+            {
+                Environment.ExitCode = HeadlessCapture.Run(args.Skip(1).ToArray());
+                return;
+            }
+
+            if (args.Length > 0 && args[0] == "capture-benchmark-test")
+            {
+                Environment.ExitCode = HeadlessCapture.Test();
+                return;
+            }
+
+            if (args.Length > 0 && args[0] == "decode-benchmark")
+            {
+                Environment.ExitCode = PlayerDecoding.Run(args.Skip(1).ToArray());
+                return;
+            }
+
+            if (args.Length > 0 && args[0] == "decode-prebuffer-test")
+            {
+                Environment.ExitCode = PlayerDecoding.TestStepAfterBackwardFill();
+                return;
+            }
+
             //TestKVAFuzzer();
             //TestKSVFuzzer();
             //TestHistoryStack();
@@ -21,6 +46,9 @@ namespace Kinovea.Tests
 
             // Performance
             //ImageCopy.Test();
+            //MJPEGRecording.Test();
+            //ConsumerWaitStrategies.Test();
+            //ProducerGating.Test();
         }
         private static void TestKVAFuzzer()
         {
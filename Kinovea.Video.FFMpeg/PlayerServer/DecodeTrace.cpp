@@ -0,0 +1,133 @@
+#pragma region License
+/*
+Copyright  Joan Charmant 2015.
+joan.charmant@gmail.com
+
+This file is part of Kinovea.
+
+Kinovea is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2
+as published by the Free Software Foundation.
+
+Kinovea is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Kinovea. If not, see http://www.gnu.org/licenses/.
+
+*/
+#pragma endregion
+
+#include "DecodeTrace.h"
+
+using namespace System::Globalization;
+using namespace System::IO;
+using namespace System::Text;
+using namespace Kinovea::Video::FFMpeg;
+
+DecodeTrace::DecodeTrace()
+{
+    m_Events = gcnew array<DecodeTraceEvent>(m_iCapacity);
+}
+
+int64_t DecodeTrace::Now()
+{
+    return m_bEnabled ? Stopwatch::GetTimestamp() : 0;
+}
+
+void DecodeTrace::Record(DecodeStage _stage, int64_t _start, int64_t _timestamp)
+{
+    // A span started while the trace was disabled is ignored.
+    if (!m_bEnabled || _start == 0)
+        return;
+
+    int64_t end = Stopwatch::GetTimestamp();
+    int64_t index = Interlocked::Increment(m_iWritten) - 1;
+    
+    DecodeTraceEvent% e = m_Events[(int)(index & (m_iCapacity - 1))];
+    e.Stage = _stage;
+    e.Start = _start;
+    e.End = end;
+    e.ThreadId = Thread::CurrentThread->ManagedThreadId;
+    e.Timestamp = _timestamp;
+}
+
+void DecodeTrace::Clear()
+{
+    Interlocked::Exchange(m_iWritten, (int64_t)0);
+}
+
+///<summary>
+/// DecodeTrace::Snapshot
+/// Copy of the events currently in the ring, oldest first.
+///</summary>
+array<DecodeTraceEvent>^ DecodeTrace::Snapshot()
+{
+    int64_t written = Interlocked::Read(m_iWritten);
+    int count = (int)Math::Min(written, (int64_t)m_iCapacity);
+    array<DecodeTraceEvent>^ events = gcnew array<DecodeTraceEvent>(count);
+    
+    int64_t first = written - count;
+    for (int i = 0; i < count; i++)
+        events[i] = m_Events[(int)((first + i) & (m_iCapacity - 1))];
+
+    return events;
+}
+
+///<summary>
+/// DecodeTrace::ToChromeTrace
+/// Complete events ("ph":"X") in microseconds relative to the oldest event.
+/// Spans of the same thread nest by time, so the stages show up under their ReadFrame.
+///</summary>
+String^ DecodeTrace::ToChromeTrace()
+{
+    array<DecodeTraceEvent>^ events = Snapshot();
+    double ticksToMicroseconds = 1000000.0 / Stopwatch::Frequency;
+    int pid = Process::GetCurrentProcess()->Id;
+
+    int64_t origin = Int64::MaxValue;
+    for each (DecodeTraceEvent e in events)
+        origin = Math::Min(origin, e.Start);
+
+    StringBuilder^ b = gcnew StringBuilder();
+    b->Append("{\"traceEvents\":[");
+    
+    for (int i = 0; i < events->Length; i++)
+    {
+        DecodeTraceEvent e = events[i];
+        if (i > 0)
+            b->Append(",");
+
+        b->AppendLine();
+        b->AppendFormat(CultureInfo::InvariantCulture, 
+            "{{\"name\":\"{0}\",\"cat\":\"decode\",\"ph\":\"X\",\"ts\":{1:0.000},\"dur\":{2:0.000},\"pid\":{3},\"tid\":{4},\"args\":{{\"timestamp\":{5}}}}}",
+            GetName(e.Stage), (e.Start - origin) * ticksToMicroseconds, (e.End - e.Start) * ticksToMicroseconds, pid, e.ThreadId, e.Timestamp);
+    }
+
+    b->AppendLine();
+    b->Append("],\"displayTimeUnit\":\"ms\"}");
+    return b->ToString();
+}
+
+void DecodeTrace::ExportChromeTrace(String^ _filePath)
+{
+    File::WriteAllText(_filePath, ToChromeTrace());
+}
+
+String^ DecodeTrace::GetName(DecodeStage _stage)
+{
+    switch (_stage)
+    {
+    case DecodeStage::ReadFrame: return "ReadFrame";
+    case DecodeStage::Seek: return "Seek";
+    case DecodeStage::Demux: return "Demux";
+    case DecodeStage::Decode: return "Decode";
+    case DecodeStage::Discard: return "Discard";
+    case DecodeStage::Convert: return "Convert";
+    case DecodeStage::Wrap: return "Wrap";
+    case DecodeStage::Add: return "Add";
+    default: return "Unknown";
+    }
+}
@@ -0,0 +1,98 @@
+#pragma region License
+/*
+Copyright  Joan Charmant 2015.
+joan.charmant@gmail.com
+
+This file is part of Kinovea.
+
+Kinovea is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2
+as published by the Free Software Foundation.
+
+Kinovea is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Kinovea. If not, see http://www.gnu.org/licenses/.
+
+*/
+#pragma endregion
+
+#pragma once
+
+#include <stdint.h>
+
+using namespace System;
+using namespace System::Diagnostics;
+using namespace System::Threading;
+
+namespace Kinovea { namespace Video { namespace FFMpeg
+{
+    /// <summary>
+    /// Stages of ReadFrame recorded in the decode trace.
+    /// Discard is the decoding of a frame that is not kept: on the way to a seek target or skipped during playback.
+    /// </summary>
+    public enum class DecodeStage
+    {
+        ReadFrame,
+        Seek,
+        Demux,
+        Decode,
+        Discard,
+        Convert,
+        Wrap,
+        Add
+    };
+
+    /// <summary>
+    /// A single span of the decode trace. Times are in Stopwatch ticks.
+    /// </summary>
+    public value struct DecodeTraceEvent
+    {
+        DecodeStage Stage;
+        int64_t Start;
+        int64_t End;
+        int ThreadId;
+        int64_t Timestamp;      // Video timestamp the span relates to, -1 if not known.
+    };
+
+    /// <summary>
+    /// Low overhead trace of the decoding stages, to find where the time goes in ReadFrame.
+    /// Spans are written to a fixed size ring, the oldest being overwritten.
+    /// Writers claim a slot with an interlocked increment and never block.
+    /// A snapshot taken while decoding may contain one partially written event.
+    /// When the trace is disabled, Now() returns 0 and Record() returns immediately.
+    /// The trace can be exported in Chrome trace event format, for chrome://tracing or Perfetto.
+    /// </summary>
+    public ref class DecodeTrace
+    {
+    public:
+        DecodeTrace();
+
+        property bool Enabled {
+            bool get() { return m_bEnabled; }
+            void set(bool value) { m_bEnabled = value; }
+        }
+
+        /// <summary>Start time of a span, or 0 if the trace is disabled.</summary>
+        int64_t Now();
+
+        /// <summary>Close a span started with Now().</summary>
+        void Record(DecodeStage _stage, int64_t _start, int64_t _timestamp);
+
+        void Clear();
+        array<DecodeTraceEvent>^ Snapshot();
+        String^ ToChromeTrace();
+        void ExportChromeTrace(String^ _filePath);
+
+    private:
+        static String^ GetName(DecodeStage _stage);
+
+        static const int m_iCapacity = 1 << 16;
+        array<DecodeTraceEvent>^ m_Events;
+        int64_t m_iWritten;
+        volatile bool m_bEnabled;
+    };
+}}}
@@ -0,0 +1,42 @@
+/*
+Copyright  Joan Charmant 2015.
+joan.charmant@gmail.com 
+ 
+This file is part of Kinovea.
+
+Kinovea is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 
+as published by the Free Software Foundation.
+
+Kinovea is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Kinovea. If not, see http://www.gnu.org/licenses/.
+
+*/
+
+#pragma once
+
+namespace Kinovea { namespace Video { namespace FFMpeg
+{
+    /// <summary>
+    /// Resources needed to convert and encode one frame at a time.
+    /// Allocated once for the whole recording and reused for each frame.
+    /// In parallel encoding mode each encoder thread has its own instance.
+    /// </summary>
+    public ref class EncodingContext
+    {
+    public:
+        AVCodecContext* pCodecContext;      // Encoder parameters. Either the stream encoder or a private copy.
+        bool bOwnsCodecContext;             // Whether the codec context was allocated for this encoding context.
+        AVFrame* pInputFrame;               // Wrapper around the incoming buffer.
+        SwsContext* pScalingContext;        // Color conversion from input pixel format to encoder pixel format.
+        AVFrame* pEncodingFrame;            // Color converted frame, input of the encoder.
+        uint8_t* pEncodingBuffer;           // Image data of pEncodingFrame.
+        uint8_t* pOutputBuffer;             // Encoded sample, used in synchronous mode only.
+        int iOutputBufferSize;
+    };
+}}}
@@ -0,0 +1,40 @@
+/*
+Copyright  Joan Charmant 2015.
+joan.charmant@gmail.com 
+ 
+This file is part of Kinovea.
+
+Kinovea is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 
+as published by the Free Software Foundation.
+
+Kinovea is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Kinovea. If not, see http://www.gnu.org/licenses/.
+
+*/
+
+#pragma once
+
+namespace Kinovea { namespace Video { namespace FFMpeg
+{
+    /// <summary>
+    /// A frame travelling through the parallel encoders.
+    /// The input bytes are copied in so the ring buffer slot can be released right away.
+    /// The output buffer must live until the sample has been written to the file in capture order.
+    /// </summary>
+    public ref class EncodingJob
+    {
+    public:
+        int64_t iSequence;                  // Position of the frame in the recording.
+        uint8_t* pInputBuffer;
+        int iInputBufferSize;
+        uint8_t* pOutputBuffer;
+        int iOutputBufferSize;
+        int iEncodedSize;
+    };
+}}}
@@ -18,6 +18,8 @@ along with Kinovea. If not, see http://www.gnu.org/licenses/.
 
 */
 
+#include <string.h>
+#include <msclr\lock.h>
 #include "MJPEGWriter.h"
 
 using namespace System::Diagnostics;
@@ -28,10 +30,20 @@ using namespace System::Runtime::InteropServices;
 
 using namespace Kinovea::Video;
 using namespace Kinovea::Video::FFMpeg;
+using namespace msclr;
 
 MJPEGWriter::MJPEGWriter()
 {
     av_register_all();
+
+    m_EncoderThreads = gcnew List<Thread^>();
+    m_EncodingContexts = gcnew List<EncodingContext^>();
+    m_Jobs = gcnew List<EncodingJob^>();
+    m_FreeJobs = gcnew Queue<EncodingJob^>();
+    m_PendingJobs = gcnew Queue<EncodingJob^>();
+    m_EncodedJobs = gcnew Dictionary<int64_t, EncodingJob^>();
+    m_JobsLocker = gcnew Object();
+    m_MuxerLocker = gcnew Object();
 }
 MJPEGWriter::~MJPEGWriter()
 {
@@ -43,8 +55,20 @@ MJPEGWriter::!MJPEGWriter()
 ///<summary>
 /// MJPEGWriter::OpenSavingContext
 /// Open a saving context and configure it with default parameters.
+/// Frames will be encoded synchronously in SaveFrame.
 ///</summary>
-SaveResult MJPEGWriter::OpenSavingContext(String^ _filePath, VideoInfo _info, String^ _formatString, double _fFramesInterval)
+SaveResult MJPEGWriter::OpenSavingContext(String^ _filePath, VideoInfo _info, String^ _formatString, ImageFormat _inputFormat, double _fFramesInterval)
+{
+    return OpenSavingContext(_filePath, _info, _formatString, _inputFormat, _fFramesInterval, 1);
+}
+
+///<summary>
+/// MJPEGWriter::OpenSavingContext
+/// Open a saving context and configure it with default parameters.
+/// If more than one encoder is asked, frames are encoded in parallel by that many threads
+/// and written to the file in the order they were passed to SaveFrame.
+///</summary>
+SaveResult MJPEGWriter::OpenSavingContext(String^ _filePath, VideoInfo _info, String^ _formatString, ImageFormat _inputFormat, double _fFramesInterval, int _encoders)
 {
     //---------------------------------------------------------------------------------------------------
     // Set the saving context up.
@@ -58,6 +82,7 @@ SaveResult MJPEGWriter::OpenSavingContext(String^ _filePath, VideoInfo _info, St
         delete m_SavingContext;
     
     m_SavingContext = gcnew SavingContext();
+    m_InputFormat = _inputFormat;
 
     m_SavingContext->pFilePath = static_cast<char*>(Marshal::StringToHGlobalAnsi(_filePath).ToPointer());
     
@@ -153,15 +178,18 @@ SaveResult MJPEGWriter::OpenSavingContext(String^ _filePath, VideoInfo _info, St
         m_SavingContext->pOutputVideoStream->codec = m_SavingContext->pOutputCodecContext;
 
         
-        // 9. Open the file.
-        averror = avio_open(&(m_SavingContext->pOutputFormatContext)->pb, m_SavingContext->pFilePath, AVIO_FLAG_WRITE);
-        if (averror < 0) 
+        // 9. Open the file. 
+        // Writes go through a dedicated I/O thread so a slow disk doesn't immediately stall the encoding.
+        m_Output = gcnew WriteBehindFile();
+        if (!m_Output->Open(_filePath, m_SavingContext->iBitrate / 8))
         {
             result = SaveResult::FileNotOpened;
-            LogError("File not opened", averror);
+            log->Error("File not opened");
             break;
         }
 
+        m_SavingContext->pOutputFormatContext->pb = m_Output->IOContext;
+
         SanityCheck(m_SavingContext->pOutputFormatContext);
 
         // 10. Write file header.
@@ -173,12 +201,28 @@ SaveResult MJPEGWriter::OpenSavingContext(String^ _filePath, VideoInfo _info, St
             break;
         }
 
-        // 11. Allocate memory for the current incoming frame holder. (will be reused for each frame). 
-        if ((m_SavingContext->pInputFrame = av_frame_alloc()) == nullptr) 
+        // 11. Allocate the color conversion contexts and the intermediate buffers. (will be reused for each frame).
+        // JPEG samples are pushed to the file as is and don't need any of this.
+        m_bParallel = _encoders > 1 && _inputFormat != ImageFormat::JPEG;
+        
+        if (m_bParallel)
         {
-            result = SaveResult::InputFrameNotAllocated;
-            log->Error("Input frame not allocated");
-            break;
+            if (!StartEncoders(_encoders))
+            {
+                result = SaveResult::EncoderNotOpened;
+                log->Error("Parallel encoders not started");
+                break;
+            }
+        }
+        else if (_inputFormat != ImageFormat::JPEG)
+        {
+            m_SavingContext->encodingContext = AllocateEncodingContext(m_SavingContext, _inputFormat, false);
+            if (m_SavingContext->encodingContext == nullptr)
+            {
+                result = SaveResult::InputFrameNotAllocated;
+                log->Error("Encoding resources not allocated");
+                break;
+            }
         }
     }
     while(false);
@@ -232,6 +276,16 @@ SaveResult MJPEGWriter::CloseSavingContext(bool _bEncodingSuccess)
 
     SaveResult result = SaveResult::Success;
 
+    // Flush the frames still in the encoders.
+    if(m_bParallel)
+    {
+        StopEncoders();
+        m_bParallel = false;
+
+        if(m_bEncoderFailed)
+            result = SaveResult::UnknownError;
+    }
+
     if(_bEncodingSuccess)
     {
         // Write file trailer.		
@@ -239,10 +293,10 @@ SaveResult MJPEGWriter::CloseSavingContext(bool _bEncodingSuccess)
     }
 
     if(m_SavingContext->bEncoderOpened)
-    {
         avcodec_close(m_SavingContext->pOutputVideoStream->codec);
-        av_free(m_SavingContext->pInputFrame);
-    }
+
+    FreeEncodingContext(m_SavingContext->encodingContext);
+    m_SavingContext->encodingContext = nullptr;
         
     Marshal::FreeHGlobal(safe_cast<IntPtr>(m_SavingContext->pFilePath));
     
@@ -253,8 +307,13 @@ SaveResult MJPEGWriter::CloseSavingContext(bool _bEncodingSuccess)
         av_freep(&(m_SavingContext->pOutputFormatContext)->streams[i]);
     }
 
-    // Close file.
-    avio_close(m_SavingContext->pOutputFormatContext->pb);
+    // Close file. Waits for the pending writes.
+    if (m_Output != nullptr)
+    {
+        m_Output->Close();
+        m_Output = nullptr;
+        m_SavingContext->pOutputFormatContext->pb = nullptr;
+    }
 
     // Release muxer parameter object.
     av_free(m_SavingContext->pOutputFormatContext);
@@ -271,16 +330,21 @@ SaveResult MJPEGWriter::SaveFrame(ImageFormat format, array<System::Byte>^ buffe
     SaveResult result = SaveResult::Success;
     bool saved = false;
 
+    if (format != m_InputFormat)
+    {
+        log->ErrorFormat("Frame format {0} does not match the saving context format {1}", format, m_InputFormat);
+        return SaveResult::UnknownError;
+    }
+
     switch (format)
     {
     case ImageFormat::RGB32:
-        saved = EncodeAndWriteVideoFrameRGB32(m_SavingContext, buffer, length);
-        break;
     case ImageFormat::RGB24:
-        saved = EncodeAndWriteVideoFrameRGB24(m_SavingContext, buffer, length);
-        break;
     case ImageFormat::Y800:
-        saved = EncodeAndWriteVideoFrameY800(m_SavingContext, buffer, length);
+        if (m_bParallel)
+            saved = EnqueueFrame(buffer, length);
+        else
+            saved = EncodeAndWriteVideoFrame(m_SavingContext, format, buffer, length);
         break;
     case ImageFormat::JPEG:
         saved = EncodeAndWriteVideoFrameJPEG(m_SavingContext, buffer, length);
@@ -405,7 +469,8 @@ bool MJPEGWriter::SetupEncoder(SavingContext^ _SavingContext)
 
     // Pixel format
     // src:ffmpeg.
-    _SavingContext->pOutputCodecContext->pix_fmt = AV_PIX_FMT_YUV420P; 	
+    // Grayscale images are encoded in full range so the luma plane can be passed to the encoder as is.
+    _SavingContext->pOutputCodecContext->pix_fmt = m_InputFormat == ImageFormat::Y800 ? AV_PIX_FMT_YUVJ420P : AV_PIX_FMT_YUV420P; 	
 
     
     // Frame rate emulation. If not zero, the lower layer (i.e. format handler) has to read frames at native frame rate.
@@ -499,295 +564,495 @@ bool MJPEGWriter::SetupEncoder(SavingContext^ _SavingContext)
 }
 
 ///<summary>
-/// Encode an RGB32 image into a JPEG and push it to the file.
+/// MJPEGWriter::AllocateEncodingContext
+/// Allocate the color conversion context and the buffers used to encode frames.
+/// These are kept for the whole recording instead of being recreated for each frame.
+/// If _privateCodecContext is true, a copy of the stream encoder is opened, so that several threads can encode simultaneously.
+/// Returns nullptr if anything could not be allocated.
 ///</summary>
-bool MJPEGWriter::EncodeAndWriteVideoFrameRGB32(SavingContext^ _SavingContext, array<System::Byte>^ managedBuffer, Int64 length)
+EncodingContext^ MJPEGWriter::AllocateEncodingContext(SavingContext^ _SavingContext, ImageFormat _inputFormat, bool _privateCodecContext)
 {
-    bool written = false;
-    
-    AVFrame* pYUV420Frame = nullptr;
-    uint8_t* pYUV420Buffer = nullptr;
-    uint8_t* pJpegBuffer = nullptr;
+    EncodingContext^ context = gcnew EncodingContext();
+    bool allocated = false;
+
+    int width = _SavingContext->outputSize.Width;
+    int height = _SavingContext->outputSize.Height;
     
     do
     {
-        int outWidth = _SavingContext->outputSize.Width;
-        int outHeight = _SavingContext->outputSize.Height;
-        int inWidth = outWidth;
-        int inHeight = outHeight;
-
-        pin_ptr<uint8_t> pRGB32Buffer = &managedBuffer[0];
-        avpicture_fill((AVPicture*)_SavingContext->pInputFrame, pRGB32Buffer, AV_PIX_FMT_BGRA, inWidth, inHeight);
-        
-        // Alter planes and stride to vertically flip image during conversion.
-        //_SavingContext->pInputFrame->data[0] += _SavingContext->pInputFrame->linesize[0] * (inHeight - 1);
-        //_SavingContext->pInputFrame->linesize[0] = - _SavingContext->pInputFrame->linesize[0];
-
-        // Prepare the color space converted frame.
-        if ((pYUV420Frame = av_frame_alloc()) == nullptr) 
+        AVPixelFormat inputPixelFormat = GetPixelFormat(_inputFormat);
+        if (inputPixelFormat == AV_PIX_FMT_NONE)
         {
-            log->Error("YUV420P frame not allocated");
+            log->ErrorFormat("Unsupported input format: {0}", _inputFormat);
             break;
         }
 
-        int yuvBufferSize = avpicture_get_size(AV_PIX_FMT_YUV420P, outWidth, outHeight);
-        pYUV420Buffer = (uint8_t*)av_malloc(yuvBufferSize);
+        // Encoder.
+        if (_privateCodecContext)
+        {
+            if ((context->pCodecContext = avcodec_alloc_context3(_SavingContext->pOutputCodec)) == nullptr)
+            {
+                log->Error("Encoder parameters not allocated");
+                break;
+            }
+
+            context->bOwnsCodecContext = true;
+
+            int averror = avcodec_copy_context(context->pCodecContext, _SavingContext->pOutputCodecContext);
+            if (averror < 0)
+            {
+                LogError("Encoder parameters not copied", averror);
+                break;
+            }
 
-        if (pYUV420Buffer == nullptr) 
+            averror = avcodec_open2(context->pCodecContext, _SavingContext->pOutputCodec, nullptr);
+            if (averror < 0)
+            {
+                LogError("Encoder not opened", averror);
+                break;
+            }
+        }
+        else
         {
-            log->Error("YUV frame buffer not allocated");
+            context->pCodecContext = _SavingContext->pOutputCodecContext;
+        }
+
+        // Holder for the incoming frame.
+        if ((context->pInputFrame = av_frame_alloc()) == nullptr) 
+        {
+            log->Error("Input frame not allocated");
             break;
         }
-        
-        avpicture_fill((AVPicture*)pYUV420Frame, pYUV420Buffer, AV_PIX_FMT_YUV420P, outWidth, outHeight);
-        
-        // Perform the color space conversion.
-        SwsContext* scalingContext = sws_getContext(
-            inWidth, inHeight, AV_PIX_FMT_BGRA, 
-            outWidth, outHeight, AV_PIX_FMT_YUV420P, SWS_FAST_BILINEAR,
-            NULL, NULL, NULL);
 
-        if (sws_scale(scalingContext, _SavingContext->pInputFrame->data, _SavingContext->pInputFrame->linesize, 0, inHeight, pYUV420Frame->data, pYUV420Frame->linesize) < 0) 
+        // Color space converted frame, this is what is actually passed to the encoder.
+        if ((context->pEncodingFrame = av_frame_alloc()) == nullptr) 
         {
-            log->Error("scaling failed");
-            sws_freeContext(scalingContext);
+            log->Error("YUV420P frame not allocated");
             break;
         }
 
-        sws_freeContext(scalingContext);
+        AVPixelFormat encodingPixelFormat = context->pCodecContext->pix_fmt;
+        int yuvBufferSize = avpicture_get_size(encodingPixelFormat, width, height);
+        context->pEncodingBuffer = (uint8_t*)av_malloc(yuvBufferSize);
+        if (context->pEncodingBuffer == nullptr) 
+        {
+            log->Error("YUV frame buffer not allocated");
+            break;
+        }
 
-        // Allocated JPEG frame buffer. 
-        // Assumes uncompressed size is always smaller than compressed. (Not technically true).
-        int jpegBufferSize = yuvBufferSize;
-        pJpegBuffer = (uint8_t*)av_malloc(jpegBufferSize);
+        avpicture_fill((AVPicture*)context->pEncodingFrame, context->pEncodingBuffer, encodingPixelFormat, width, height);
 
-        if (pJpegBuffer == nullptr) 
+        // JPEG frame buffer. 
+        // Assumes compressed size is always smaller than uncompressed. (Not technically true).
+        context->iOutputBufferSize = yuvBufferSize;
+        context->pOutputBuffer = (uint8_t*)av_malloc(context->iOutputBufferSize);
+        if (context->pOutputBuffer == nullptr) 
         {
             log->Error("output video buffer not allocated");
             break;
         }
 
-        // Actual encode.
-        int jpegSize = avcodec_encode_video(_SavingContext->pOutputCodecContext, pJpegBuffer, jpegBufferSize, pYUV420Frame);
+        // Grayscale fast path: the incoming image is used directly as the luma plane of the encoded frame,
+        // and the chroma planes are set to neutral once and for all. No color conversion.
+        if (_inputFormat == ImageFormat::Y800)
+        {
+            int chromaSize = context->pEncodingFrame->linesize[1] * ((height + 1) / 2);
+            memset(context->pEncodingFrame->data[1], 128, chromaSize);
+            memset(context->pEncodingFrame->data[2], 128, chromaSize);
+            allocated = true;
+            break;
+        }
+
+        // Color conversion.
+        context->pScalingContext = sws_getContext(
+            width, height, inputPixelFormat, 
+            width, height, encodingPixelFormat, 
+            SWS_FAST_BILINEAR, NULL, NULL, NULL);
 
-        if (jpegSize > 0)
-            WriteFrame(jpegSize, _SavingContext, pJpegBuffer, true);
+        if (context->pScalingContext == nullptr)
+        {
+            log->Error("scaling context not allocated");
+            break;
+        }
 
-        written = true;
+        allocated = true;
     }
     while(false);
 
-    if (pJpegBuffer != nullptr)
-        av_free(pJpegBuffer);
+    if (!allocated)
+    {
+        FreeEncodingContext(context);
+        return nullptr;
+    }
+
+    return context;
+}
+
+///<summary>
+/// MJPEGWriter::FreeEncodingContext
+/// Release whatever was allocated by AllocateEncodingContext, even partially.
+///</summary>
+void MJPEGWriter::FreeEncodingContext(EncodingContext^ _EncodingContext)
+{
+    if (_EncodingContext == nullptr)
+        return;
+
+    if (_EncodingContext->pScalingContext != nullptr)
+        sws_freeContext(_EncodingContext->pScalingContext);
+
+    if (_EncodingContext->pOutputBuffer != nullptr)
+        av_free(_EncodingContext->pOutputBuffer);
 
-    if (pYUV420Frame != nullptr)
-        av_free(pYUV420Frame);
+    if (_EncodingContext->pEncodingFrame != nullptr)
+        av_free(_EncodingContext->pEncodingFrame);
 
-    if (pYUV420Buffer != nullptr)
-        av_free(pYUV420Buffer);
+    if (_EncodingContext->pEncodingBuffer != nullptr)
+        av_free(_EncodingContext->pEncodingBuffer);
 
-    return written;
+    if (_EncodingContext->pInputFrame != nullptr)
+        av_free(_EncodingContext->pInputFrame);
+
+    if (_EncodingContext->bOwnsCodecContext && _EncodingContext->pCodecContext != nullptr)
+    {
+        avcodec_close(_EncodingContext->pCodecContext);
+        av_free(_EncodingContext->pCodecContext);
+    }
+
+    _EncodingContext->pScalingContext = nullptr;
+    _EncodingContext->pOutputBuffer = nullptr;
+    _EncodingContext->iOutputBufferSize = 0;
+    _EncodingContext->pEncodingFrame = nullptr;
+    _EncodingContext->pEncodingBuffer = nullptr;
+    _EncodingContext->pInputFrame = nullptr;
+    _EncodingContext->pCodecContext = nullptr;
+    _EncodingContext->bOwnsCodecContext = false;
 }
 
+AVPixelFormat MJPEGWriter::GetPixelFormat(ImageFormat _format)
+{
+    switch (_format)
+    {
+    case ImageFormat::RGB32:
+        return AV_PIX_FMT_BGRA;
+    case ImageFormat::RGB24:
+        return AV_PIX_FMT_BGR24;
+    case ImageFormat::Y800:
+        return AV_PIX_FMT_GRAY8;
+    default:
+        return AV_PIX_FMT_NONE;
+    }
+}
 
 ///<summary>
-/// Encode an RGB24 image into a JPEG and push it to the file.
+/// MJPEGWriter::EncodeAndWriteVideoFrame
+/// Encode an RGB32, RGB24 or Y800 image into a JPEG and push it to the file, synchronously.
 ///</summary>
-bool MJPEGWriter::EncodeAndWriteVideoFrameRGB24(SavingContext^ _SavingContext, array<System::Byte>^ managedBuffer, Int64 length)
+bool MJPEGWriter::EncodeAndWriteVideoFrame(SavingContext^ _SavingContext, ImageFormat _format, array<System::Byte>^ managedBuffer, Int64 length)
 {
-    bool written = false;
+    EncodingContext^ context = _SavingContext->encodingContext;
+    if (context == nullptr)
+    {
+        log->Error("Encoding resources not allocated");
+        return false;
+    }
+
+    pin_ptr<uint8_t> pInputBuffer = &managedBuffer[0];
+    int jpegSize = EncodeVideoFrame(context, _format, pInputBuffer, context->pOutputBuffer, context->iOutputBufferSize);
     
-    AVFrame* pYUV420Frame = nullptr;
-    uint8_t* pYUV420Buffer = nullptr;
-    uint8_t* pJpegBuffer = nullptr;
+    if (jpegSize < 0)
+        return false;
+
+    if (jpegSize > 0)
+        WriteFrame(jpegSize, _SavingContext, context->pOutputBuffer, true);
+
+    return true;
+}
+
+///<summary>
+/// MJPEGWriter::EncodeVideoFrame
+/// Convert the input buffer to the encoder pixel format and encode it into the output buffer.
+/// Returns the size of the encoded sample, or a negative value on error.
+/// Only touches the passed encoding context, so it can run concurrently on distinct contexts.
+///</summary>
+int MJPEGWriter::EncodeVideoFrame(EncodingContext^ _EncodingContext, ImageFormat _format, uint8_t* _pInputBuffer, uint8_t* _pOutputBuffer, int _iOutputBufferSize)
+{
+    int width = _EncodingContext->pCodecContext->width;
+    int height = _EncodingContext->pCodecContext->height;
+    AVFrame* pInputFrame = _EncodingContext->pInputFrame;
+
+    if (_format == ImageFormat::Y800)
+    {
+        // Pass the luma plane straight to the encoder. Chroma planes are already neutral.
+        _EncodingContext->pEncodingFrame->data[0] = _pInputBuffer;
+        _EncodingContext->pEncodingFrame->linesize[0] = width;
+        return avcodec_encode_video(_EncodingContext->pCodecContext, _pOutputBuffer, _iOutputBufferSize, _EncodingContext->pEncodingFrame);
+    }
+
+    avpicture_fill((AVPicture*)pInputFrame, _pInputBuffer, GetPixelFormat(_format), width, height);
     
-    do
+    // RGB24 buffers are bottom-up.
+    // Alter planes and stride to vertically flip image during conversion.
+    if (_format == ImageFormat::RGB24)
     {
-        int outWidth = _SavingContext->outputSize.Width;
-        int outHeight = _SavingContext->outputSize.Height;
-        int inWidth = outWidth;
-        int inHeight = outHeight;
+        pInputFrame->data[0] += pInputFrame->linesize[0] * (height - 1);
+        pInputFrame->linesize[0] = - pInputFrame->linesize[0];
+    }
 
-        pin_ptr<uint8_t> pRGB24Buffer = &managedBuffer[0];
-        avpicture_fill((AVPicture*)_SavingContext->pInputFrame, pRGB24Buffer, AV_PIX_FMT_BGR24, inWidth, inHeight);
-        
-        // Alter planes and stride to vertically flip image during conversion.
-        _SavingContext->pInputFrame->data[0] += _SavingContext->pInputFrame->linesize[0] * (inHeight - 1);
-        _SavingContext->pInputFrame->linesize[0] = - _SavingContext->pInputFrame->linesize[0];
+    // Perform the color space conversion.
+    if (sws_scale(_EncodingContext->pScalingContext, 
+        pInputFrame->data, pInputFrame->linesize, 0, height, 
+        _EncodingContext->pEncodingFrame->data, _EncodingContext->pEncodingFrame->linesize) < 0) 
+    {
+        log->Error("scaling failed");
+        return -1;
+    }
 
-        // Prepare the color space converted frame.
-        if ((pYUV420Frame = av_frame_alloc()) == nullptr) 
-        {
-            log->Error("YUV420P frame not allocated");
-            break;
-        }
+    // Actual encode.
+    return avcodec_encode_video(_EncodingContext->pCodecContext, _pOutputBuffer, _iOutputBufferSize, _EncodingContext->pEncodingFrame);
+}
 
-        int yuvBufferSize = avpicture_get_size(AV_PIX_FMT_YUV420P, outWidth, outHeight);
-        pYUV420Buffer = (uint8_t*)av_malloc(yuvBufferSize);
+///<summary>
+/// MJPEGWriter::StartEncoders
+/// Allocate the encoding contexts and the frame pool, and start the encoder threads.
+/// Frames are copied into the pool so the caller can reuse its buffer as soon as SaveFrame returns.
+///</summary>
+bool MJPEGWriter::StartEncoders(int _encoders)
+{
+    int width = m_SavingContext->outputSize.Width;
+    int height = m_SavingContext->outputSize.Height;
+    int inputBufferSize = avpicture_get_size(GetPixelFormat(m_InputFormat), width, height);
+    int outputBufferSize = avpicture_get_size(m_SavingContext->pOutputCodecContext->pix_fmt, width, height);
+    
+    // Enough frames so that each encoder has one in progress and one waiting.
+    int jobs = _encoders * 2;
 
-        if (pYUV420Buffer == nullptr) 
+    m_bStopEncoders = false;
+    m_bEncoderFailed = false;
+    m_iNextSequence = 0;
+    m_iNextToWrite = 0;
+    
+    for (int i = 0; i < _encoders; i++)
+    {
+        EncodingContext^ context = AllocateEncodingContext(m_SavingContext, m_InputFormat, true);
+        if (context == nullptr)
         {
-            log->Error("YUV frame buffer not allocated");
-            break;
+            StopEncoders();
+            return false;
         }
+
+        m_EncodingContexts->Add(context);
+    }
+
+    for (int i = 0; i < jobs; i++)
+    {
+        EncodingJob^ job = gcnew EncodingJob();
+        m_Jobs->Add(job);
         
-        avpicture_fill((AVPicture*)pYUV420Frame, pYUV420Buffer, AV_PIX_FMT_YUV420P, outWidth, outHeight);
+        job->iInputBufferSize = inputBufferSize;
+        job->pInputBuffer = (uint8_t*)av_malloc(inputBufferSize);
+        job->iOutputBufferSize = outputBufferSize;
+        job->pOutputBuffer = (uint8_t*)av_malloc(outputBufferSize);
         
-        // Perform the color space conversion.
-        SwsContext* scalingContext = sws_getContext(
-            inWidth, inHeight, AV_PIX_FMT_BGR24, 
-            outWidth, outHeight, AV_PIX_FMT_YUV420P, SWS_FAST_BILINEAR,
-            NULL, NULL, NULL);
-
-        if (sws_scale(scalingContext, _SavingContext->pInputFrame->data, _SavingContext->pInputFrame->linesize, 0, inHeight, pYUV420Frame->data, pYUV420Frame->linesize) < 0) 
+        if (job->pInputBuffer == nullptr || job->pOutputBuffer == nullptr)
         {
-            log->Error("scaling failed");
-            sws_freeContext(scalingContext);
-            break;
+            log->Error("Encoding job buffers not allocated");
+            StopEncoders();
+            return false;
         }
 
-        sws_freeContext(scalingContext);
+        m_FreeJobs->Enqueue(job);
+    }
 
-        // Allocated JPEG frame buffer. 
-        // Assumes uncompressed size is always smaller than compressed. (Not technically true).
-        int jpegBufferSize = yuvBufferSize;
-        pJpegBuffer = (uint8_t*)av_malloc(jpegBufferSize);
+    for (int i = 0; i < m_EncodingContexts->Count; i++)
+    {
+        Thread^ thread = gcnew Thread(gcnew ParameterizedThreadStart(this, &MJPEGWriter::EncodingWorker));
+        thread->Name = String::Format("MJPEGEncoder{0}", i);
+        thread->IsBackground = true;
+        m_EncoderThreads->Add(thread);
+        thread->Start(m_EncodingContexts[i]);
+    }
 
-        if (pJpegBuffer == nullptr) 
-        {
-            log->Error("output video buffer not allocated");
-            break;
-        }
+    log->DebugFormat("Started {0} MJPEG encoder threads.", _encoders);
+    return true;
+}
+
+///<summary>
+/// MJPEGWriter::StopEncoders
+/// Wait for the encoder threads to encode and write all pending frames, then release everything.
+///</summary>
+void MJPEGWriter::StopEncoders()
+{
+    {
+        lock l(m_JobsLocker);
+        m_bStopEncoders = true;
+        Monitor::PulseAll(m_JobsLocker);
+    }
 
-        // Actual encode.
-        int jpegSize = avcodec_encode_video(_SavingContext->pOutputCodecContext, pJpegBuffer, jpegBufferSize, pYUV420Frame);
+    for each (Thread^ thread in m_EncoderThreads)
+        thread->Join();
 
-        if (jpegSize > 0)
-            WriteFrame(jpegSize, _SavingContext, pJpegBuffer, true);
+    m_EncoderThreads->Clear();
 
-        written = true;
-    }
-    while(false);
+    if (m_EncodedJobs->Count > 0)
+        log->ErrorFormat("{0} encoded frames could not be written in order.", m_EncodedJobs->Count);
 
-    if (pJpegBuffer != nullptr)
-        av_free(pJpegBuffer);
+    for each (EncodingContext^ context in m_EncodingContexts)
+        FreeEncodingContext(context);
 
-    if (pYUV420Frame != nullptr)
-        av_free(pYUV420Frame);
+    for each (EncodingJob^ job in m_Jobs)
+    {
+        if (job->pInputBuffer != nullptr)
+            av_free(job->pInputBuffer);
 
-    if (pYUV420Buffer != nullptr)
-        av_free(pYUV420Buffer);
+        if (job->pOutputBuffer != nullptr)
+            av_free(job->pOutputBuffer);
+    }
 
-    //if (pRGB24Frame != nullptr)
-        //av_free(pRGB24Frame);
-    
-    return written;
-}
+    m_EncodingContexts->Clear();
+    m_Jobs->Clear();
+    m_FreeJobs->Clear();
+    m_PendingJobs->Clear();
+    m_EncodedJobs->Clear();
 
+    log->Debug("MJPEG encoder threads stopped.");
+}
 
 ///<summary>
-/// VideoFileWriter::EncodeAndWriteVideoFrameRGB24
+/// MJPEGWriter::EnqueueFrame
+/// Copy the frame into a free job and hand it over to the encoder threads.
+/// Blocks if all the jobs are in flight, that is, if the encoders are not keeping up, but not longer than EnqueueTimeoutMilliseconds.
+/// Returns false if the frame was dropped, or if a previous frame could not be encoded or written.
 ///</summary>
-bool MJPEGWriter::EncodeAndWriteVideoFrameY800(SavingContext^ _SavingContext, array<System::Byte>^ managedBuffer, Int64 length)
+bool MJPEGWriter::EnqueueFrame(array<System::Byte>^ managedBuffer, Int64 length)
 {
-    bool written = false;
-    bool yuvFrameAllocated = false;
+    EncodingJob^ job = nullptr;
     
-    // init to nullptr.
-    AVFrame* pInputFrame;
-    AVFrame* pYuvFrame;
-    uint8_t* pYuvBuffer;
+    {
+        lock l(m_JobsLocker);
+        Stopwatch^ stopwatch = Stopwatch::StartNew();
+        while (m_FreeJobs->Count == 0 && !m_bEncoderFailed)
+        {
+            int remaining = EnqueueTimeoutMilliseconds - (int)stopwatch->ElapsedMilliseconds;
+            if (remaining <= 0)
+            {
+                log->Error("Timeout waiting for a free encoding job, frame dropped.");
+                return false;
+            }
+
+            Monitor::Wait(m_JobsLocker, remaining);
+        }
+        
+        if (m_bEncoderFailed)
+            return false;
+
+        job = m_FreeJobs->Dequeue();
+    }
+
+    int size = (int)Math::Min(length, (Int64)job->iInputBufferSize);
+    pin_ptr<uint8_t> pInputBuffer = &managedBuffer[0];
+    memcpy(job->pInputBuffer, pInputBuffer, size);
     
-    do
+    job->iSequence = m_iNextSequence++;
+    job->iEncodedSize = 0;
+
     {
-        int outWidth = _SavingContext->outputSize.Width;
-        int outHeight = _SavingContext->outputSize.Height;
-        int inWidth = outWidth;
-        int inHeight = outHeight;
+        lock l(m_JobsLocker);
+        m_PendingJobs->Enqueue(job);
+        Monitor::PulseAll(m_JobsLocker);
+    }
 
-        pin_ptr<uint8_t> pInputBuffer = &managedBuffer[0];
+    return true;
+}
 
-        // Put the input buffer inside an AVFrame.
-        // This is needed only because we need to convert color space.
-        if ((pInputFrame = av_frame_alloc()) == nullptr) 
+///<summary>
+/// MJPEGWriter::EncodingWorker
+/// Encoder thread. Encode frames from the pending queue until stopped and the queue is empty.
+/// Failures are reported to the thread calling SaveFrame through m_bEncoderFailed.
+/// A frame that could not be encoded still goes through the sequencer so the next ones are not held back.
+/// The thread ends if writing to the file throws.
+///</summary>
+void MJPEGWriter::EncodingWorker(Object^ _EncodingContext)
+{
+    EncodingContext^ context = (EncodingContext^)_EncodingContext;
+    
+    while (true)
+    {
+        EncodingJob^ job = nullptr;
+        
         {
-            log->Error("input frame not allocated");
-            break;
-        }
+            lock l(m_JobsLocker);
+            while (m_PendingJobs->Count == 0 && !m_bStopEncoders)
+                Monitor::Wait(m_JobsLocker);
 
-        avpicture_fill((AVPicture*)pInputFrame, pInputBuffer, AV_PIX_FMT_GRAY8, inWidth, inHeight);
-        
-        
-        // Convert color space.
-        // Unfortunately the MJPEG encoder doesn't know how to work directly with Y800/GRAY8 images.
-        // Instead of directly pushing the buffer to the AVFrame we need to allocate a new buffer and convert it.
+            // Stop requests are only honored once all the pending frames are encoded.
+            if (m_PendingJobs->Count == 0)
+                break;
 
-        if ((pYuvFrame = av_frame_alloc()) == nullptr) 
-        {
-            log->Error("YUV420P frame not allocated");
-            break;
+            job = m_PendingJobs->Dequeue();
         }
 
-        int yuvBufferSize = avpicture_get_size(AV_PIX_FMT_YUV420P, outWidth, outHeight);
-        pYuvBuffer = (uint8_t*)av_malloc(yuvBufferSize);
-
-        if (pYuvBuffer == nullptr) 
+        try
         {
-            log->Error("Yuv frame buffer not allocated");
-            av_free(pYuvFrame);
-            break;
+            job->iEncodedSize = EncodeVideoFrame(context, m_InputFormat, job->pInputBuffer, job->pOutputBuffer, job->iOutputBufferSize);
         }
-        
-        avpicture_fill((AVPicture*)pYuvFrame, pYuvBuffer, AV_PIX_FMT_YUV420P, outWidth, outHeight);
-
-        yuvFrameAllocated = true;
-        
-        // Perform the color space conversion.
-        SwsContext* scalingContext = sws_getContext(
-            inWidth, inHeight, AV_PIX_FMT_GRAY8, 
-            outWidth, outHeight, AV_PIX_FMT_YUV420P, 
-            SWS_BICUBIC, NULL, NULL, NULL); 
-
-        if (sws_scale(scalingContext, pInputFrame->data, pInputFrame->linesize, 0, inHeight, pYuvFrame->data, pYuvFrame->linesize) < 0) 
+        catch (Exception^ e)
         {
-            log->Error("scaling failed");
-            sws_freeContext(scalingContext);
-            break;
+            log->ErrorFormat("Error while encoding output frame. {0}", e->Message);
+            job->iEncodedSize = -1;
         }
 
-        sws_freeContext(scalingContext);
+        if (job->iEncodedSize < 0)
+        {
+            log->Error("error while encoding output frame");
+            SetEncoderFailed();
+        }
 
-        // Allocate output frame buffer. 
-        // Assumes uncompressed size is always smaller than compressed. (Not technically true).
-        int jpegBufferSize = yuvBufferSize;
-        uint8_t* pJpegBuffer = (uint8_t*)av_malloc(jpegBufferSize);
-        if (pJpegBuffer == nullptr) 
+        try
         {
-            log->Error("output video buffer not allocated");
+            WriteInOrder(job);
+        }
+        catch (Exception^ e)
+        {
+            log->ErrorFormat("Encoder thread stopped on error while writing. {0}", e->Message);
+            SetEncoderFailed();
             break;
         }
+    }
+}
 
-        // Actual encode.
-        int jpegSize = avcodec_encode_video(_SavingContext->pOutputCodecContext, pJpegBuffer, jpegBufferSize, pYuvFrame);
-
-        if (jpegSize > 0)
-            WriteFrame(jpegSize, _SavingContext, pJpegBuffer, true);
-        
-        av_free(pJpegBuffer);
+void MJPEGWriter::SetEncoderFailed()
+{
+    // Wake up SaveFrame if it is waiting for a job that will not come back.
+    lock l(m_JobsLocker);
+    m_bEncoderFailed = true;
+    Monitor::PulseAll(m_JobsLocker);
+}
 
-        written = true;
-    }
-    while(false);
+///<summary>
+/// MJPEGWriter::WriteInOrder
+/// Sequencer. Push encoded frames to the file in capture order.
+/// A frame that finished encoding before its predecessors is parked until they are written.
+///</summary>
+void MJPEGWriter::WriteInOrder(EncodingJob^ _job)
+{
+    lock l(m_MuxerLocker);
+    
+    m_EncodedJobs->Add(_job->iSequence, _job);
 
-    if(yuvFrameAllocated)
+    EncodingJob^ next = nullptr;
+    while (m_EncodedJobs->TryGetValue(m_iNextToWrite, next))
     {
-        av_free(pYuvFrame);
-        av_free(pYuvBuffer);
-    }
+        m_EncodedJobs->Remove(m_iNextToWrite);
+        m_iNextToWrite++;
 
-    // Test y800FrameAllocated and free it.
-    
-    return written;
+        if (next->iEncodedSize > 0)
+            WriteFrame(next->iEncodedSize, m_SavingContext, next->pOutputBuffer, true);
+
+        // Give the job back to the pool.
+        lock lj(m_JobsLocker);
+        m_FreeJobs->Enqueue(next);
+        Monitor::PulseAll(m_JobsLocker);
+    }
 }
 
 ///<summary>
@@ -33,6 +33,9 @@ extern "C"
 }
 
 #include "SavingContext.h"
+#include "EncodingContext.h"
+#include "EncodingJob.h"
+#include "WriteBehindFile.h"
 
 using namespace System;
 using namespace System::Collections::Generic;				
@@ -59,20 +62,43 @@ namespace Kinovea { namespace Video { namespace FFMpeg
 
     // Public Methods
     public:
-        SaveResult OpenSavingContext(String^ _FilePath, VideoInfo _info, String^ _formatString, double _fFramesInterval);
+        SaveResult OpenSavingContext(String^ _FilePath, VideoInfo _info, String^ _formatString, ImageFormat _inputFormat, double _fFramesInterval);
+        SaveResult OpenSavingContext(String^ _FilePath, VideoInfo _info, String^ _formatString, ImageFormat _inputFormat, double _fFramesInterval, int _encoders);
         SaveResult CloseSavingContext(bool _bEncodingSuccess);
         SaveResult SaveFrame(ImageFormat format, array<System::Byte>^ buffer, Int64 length);
     
+    // Properties
+    public:
+        /// <summary>Number of chunks waiting to be written to disk.</summary>
+        property int WriteQueueDepth {
+            int get() { return m_Output == nullptr ? 0 : m_Output->QueueDepth; }
+        }
+
+        /// <summary>Average time spent in a single disk write, in milliseconds.</summary>
+        property double WriteLatency {
+            double get() { return m_Output == nullptr ? 0 : m_Output->AverageWriteLatency; }
+        }
+
     // Private Methods
     private:
         double ComputeBitrate(Size outputSize, double frameInterval);
         bool SetupMuxer(SavingContext^ _SavingContext);
         bool SetupEncoder(SavingContext^ _SavingContext);
+        EncodingContext^ AllocateEncodingContext(SavingContext^ _SavingContext, ImageFormat _inputFormat, bool _privateCodecContext);
+        void FreeEncodingContext(EncodingContext^ _EncodingContext);
         
-        bool EncodeAndWriteVideoFrameRGB32(SavingContext^ _SavingContext, array<System::Byte>^ managedBuffer, Int64 length);
-        bool EncodeAndWriteVideoFrameRGB24(SavingContext^ _SavingContext, array<System::Byte>^ managedBuffer, Int64 length);
-        bool EncodeAndWriteVideoFrameY800(SavingContext^ _SavingContext, array<System::Byte>^ managedBuffer, Int64 length);
+        bool EncodeAndWriteVideoFrame(SavingContext^ _SavingContext, ImageFormat _format, array<System::Byte>^ managedBuffer, Int64 length);
         bool EncodeAndWriteVideoFrameJPEG(SavingContext^ _SavingContext, array<System::Byte>^ managedBuffer, Int64 length);
+        int EncodeVideoFrame(EncodingContext^ _EncodingContext, ImageFormat _format, uint8_t* _pInputBuffer, uint8_t* _pOutputBuffer, int _iOutputBufferSize);
+        static AVPixelFormat GetPixelFormat(ImageFormat _format);
+
+        // Parallel encoding.
+        bool StartEncoders(int _encoders);
+        void StopEncoders();
+        bool EnqueueFrame(array<System::Byte>^ managedBuffer, Int64 length);
+        void EncodingWorker(Object^ _EncodingContext);
+        void SetEncoderFailed();
+        void WriteInOrder(EncodingJob^ _job);
 
         bool WriteFrame(int _iEncodedSize, SavingContext^ _SavingContext, uint8_t* _pOutputVideoBuffer, bool _bForceKeyframe);
         void SanityCheck(AVFormatContext* s);
@@ -83,5 +109,24 @@ namespace Kinovea { namespace Video { namespace FFMpeg
     private :
         static log4net::ILog^ log = log4net::LogManager::GetLogger(MethodBase::GetCurrentMethod()->DeclaringType);
         SavingContext^ m_SavingContext;
+        WriteBehindFile^ m_Output;
+        ImageFormat m_InputFormat;
+
+        // Parallel encoding.
+        // Locking order: m_MuxerLocker may be held when taking m_JobsLocker, never the opposite.
+        bool m_bParallel;
+        List<Thread^>^ m_EncoderThreads;
+        List<EncodingContext^>^ m_EncodingContexts;
+        List<EncodingJob^>^ m_Jobs;
+        Queue<EncodingJob^>^ m_FreeJobs;                // Guarded by m_JobsLocker.
+        Queue<EncodingJob^>^ m_PendingJobs;             // Guarded by m_JobsLocker.
+        bool m_bStopEncoders;                           // Guarded by m_JobsLocker.
+        bool m_bEncoderFailed;                          // Guarded by m_JobsLocker.
+        Dictionary<int64_t, EncodingJob^>^ m_EncodedJobs; // Guarded by m_MuxerLocker.
+        int64_t m_iNextSequence;                        // Only touched by the thread calling SaveFrame.
+        int64_t m_iNextToWrite;                         // Guarded by m_MuxerLocker.
+        Object^ m_JobsLocker;
+        Object^ m_MuxerLocker;
+        static const int EnqueueTimeoutMilliseconds = 2000;
     };
 }}}
@@ -0,0 +1,257 @@
+/*
+Copyright  Joan Charmant 2015.
+joan.charmant@gmail.com
+
+This file is part of Kinovea.
+
+Kinovea is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2
+as published by the Free Software Foundation.
+
+Kinovea is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Kinovea. If not, see http://www.gnu.org/licenses/.
+
+*/
+
+#include "PixelConverter.h"
+
+using namespace Kinovea::Video::FFMpeg;
+
+#pragma managed(push, off)
+
+#include <string.h>
+#include <intrin.h>
+#include <tmmintrin.h>
+
+typedef unsigned char uint8;
+
+static bool HasSSSE3()
+{
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 9)) != 0;
+}
+
+static const bool g_bSSSE3 = HasSSSE3();
+
+//------------------------------------------------------------------------------------------------
+// Row kernels.
+// width is the number of destination pixels, step the distance between two source pixels.
+//------------------------------------------------------------------------------------------------
+
+static void RowY800ToBGR24(const uint8* src, uint8* dst, int width, int step)
+{
+    int x = 0;
+
+    if (g_bSSSE3 && step == 1)
+    {
+        // 16 gray pixels to 48 bytes.
+        const __m128i mask0 = _mm_setr_epi8(0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4, 4, 5);
+        const __m128i mask1 = _mm_setr_epi8(5, 5, 6, 6, 6, 7, 7, 7, 8, 8, 8, 9, 9, 9, 10, 10);
+        const __m128i mask2 = _mm_setr_epi8(10, 11, 11, 11, 12, 12, 12, 13, 13, 13, 14, 14, 14, 15, 15, 15);
+
+        for (; x + 16 <= width; x += 16)
+        {
+            __m128i gray = _mm_loadu_si128((const __m128i*)(src + x));
+            uint8* out = dst + (x * 3);
+            _mm_storeu_si128((__m128i*)(out), _mm_shuffle_epi8(gray, mask0));
+            _mm_storeu_si128((__m128i*)(out + 16), _mm_shuffle_epi8(gray, mask1));
+            _mm_storeu_si128((__m128i*)(out + 32), _mm_shuffle_epi8(gray, mask2));
+        }
+    }
+
+    for (; x < width; x++)
+    {
+        uint8 value = src[x * step];
+        uint8* out = dst + (x * 3);
+        out[0] = value;
+        out[1] = value;
+        out[2] = value;
+    }
+}
+
+static void RowBGRAToBGR24(const uint8* src, uint8* dst, int width, int step)
+{
+    int x = 0;
+
+    if (g_bSSSE3 && step == 1)
+    {
+        // 16 pixels, 64 bytes to 48 bytes.
+        // Each quarter is packed to 12 bytes then the four are stitched together.
+        const __m128i mask = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+        for (; x + 16 <= width; x += 16)
+        {
+            const uint8* in = src + (x * 4);
+            __m128i a = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(in)), mask);
+            __m128i b = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(in + 16)), mask);
+            __m128i c = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(in + 32)), mask);
+            __m128i d = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(in + 48)), mask);
+
+            uint8* out = dst + (x * 3);
+            _mm_storeu_si128((__m128i*)(out), _mm_or_si128(a, _mm_slli_si128(b, 12)));
+            _mm_storeu_si128((__m128i*)(out + 16), _mm_or_si128(_mm_srli_si128(b, 4), _mm_slli_si128(c, 8)));
+            _mm_storeu_si128((__m128i*)(out + 32), _mm_or_si128(_mm_srli_si128(c, 8), _mm_slli_si128(d, 4)));
+        }
+    }
+
+    for (; x < width; x++)
+    {
+        const uint8* in = src + (x * step * 4);
+        uint8* out = dst + (x * 3);
+        out[0] = in[0];
+        out[1] = in[1];
+        out[2] = in[2];
+    }
+}
+
+static void RowBGR24ToBGR24(const uint8* src, uint8* dst, int width, int step)
+{
+    if (step == 1)
+    {
+        memcpy(dst, src, width * 3);
+        return;
+    }
+
+    for (int x = 0; x < width; x++)
+    {
+        const uint8* in = src + (x * step * 3);
+        uint8* out = dst + (x * 3);
+        out[0] = in[0];
+        out[1] = in[1];
+        out[2] = in[2];
+    }
+}
+
+typedef void (*RowKernel)(const uint8* src, uint8* dst, int width, int step);
+
+///<summary>
+/// Run a row kernel over the whole image, handling flip and downscale.
+///</summary>
+static void ConvertImage(RowKernel kernel, const uint8* src, int srcWidth, int srcHeight, int srcBytesPerPixel, bool topDown, uint8* dst, int dstStride, int downscale)
+{
+    int srcStride = srcWidth * srcBytesPerPixel;
+    int dstWidth = srcWidth / downscale;
+    int dstHeight = srcHeight / downscale;
+
+    for (int i = 0; i < dstHeight; i++)
+    {
+        int srcRow = topDown ? i * downscale : (srcHeight - 1) - (i * downscale);
+        kernel(src + (srcRow * srcStride), dst + (i * dstStride), dstWidth, downscale);
+    }
+}
+
+///<summary>
+/// Nearest neighbor enlargement of an RGB24 image.
+/// Only the first row of each group of factor rows is computed, the others are copies of it.
+///</summary>
+static void ExpandImage(const uint8* src, int srcStride, uint8* dst, int dstWidth, int dstHeight, int dstStride, int factor)
+{
+    for (int i = 0; i < dstHeight; i++)
+    {
+        uint8* out = dst + (i * dstStride);
+        if (i % factor != 0)
+        {
+            memcpy(out, out - dstStride, dstWidth * 3);
+            continue;
+        }
+
+        const uint8* in = src + ((i / factor) * srcStride);
+        for (int x = 0; x < dstWidth; x++)
+        {
+            const uint8* pixel = in + ((x / factor) * 3);
+            out[x * 3 + 0] = pixel[0];
+            out[x * 3 + 1] = pixel[1];
+            out[x * 3 + 2] = pixel[2];
+        }
+    }
+}
+
+#pragma managed(pop)
+
+bool PixelConverter::Vectorized::get()
+{
+    return g_bSSSE3;
+}
+
+BitmapData^ PixelConverter::LockDestination(Bitmap^ _bitmap, Size _size, int _downscale)
+{
+    if (_downscale != 1 && _downscale != 2 && _downscale != 4)
+        throw gcnew ArgumentException("Downscale factor must be 1, 2 or 4.");
+
+    Rectangle rect(0, 0, _size.Width / _downscale, _size.Height / _downscale);
+    if (_bitmap->Width < rect.Width || _bitmap->Height < rect.Height || _bitmap->PixelFormat != PixelFormat::Format24bppRgb)
+        throw gcnew ArgumentException("Destination bitmap must be RGB24 and at least the downscaled size.");
+
+    return _bitmap->LockBits(rect, ImageLockMode::WriteOnly, _bitmap->PixelFormat);
+}
+
+///<summary>
+/// PixelConverter::FillFromRGB24
+/// Copy an RGB24 buffer into the bitmap, row by row.
+///</summary>
+void PixelConverter::FillFromRGB24(Bitmap^ _bitmap, Size _size, bool _topDown, array<System::Byte>^ _buffer, int _downscale)
+{
+    BitmapData^ bmpData = LockDestination(_bitmap, _size, _downscale);
+    pin_ptr<System::Byte> pBuffer = &_buffer[0];
+
+    ConvertImage(RowBGR24ToBGR24, pBuffer, _size.Width, _size.Height, 3, _topDown, (uint8*)bmpData->Scan0.ToPointer(), bmpData->Stride, _downscale);
+
+    _bitmap->UnlockBits(bmpData);
+}
+
+///<summary>
+/// PixelConverter::FillFromRGB32
+/// Copy an RGB32 buffer into the bitmap, dropping the alpha channel.
+///</summary>
+void PixelConverter::FillFromRGB32(Bitmap^ _bitmap, Size _size, bool _topDown, array<System::Byte>^ _buffer, int _downscale)
+{
+    BitmapData^ bmpData = LockDestination(_bitmap, _size, _downscale);
+    pin_ptr<System::Byte> pBuffer = &_buffer[0];
+
+    ConvertImage(RowBGRAToBGR24, pBuffer, _size.Width, _size.Height, 4, _topDown, (uint8*)bmpData->Scan0.ToPointer(), bmpData->Stride, _downscale);
+
+    _bitmap->UnlockBits(bmpData);
+}
+
+///<summary>
+/// PixelConverter::FillFromY800
+/// Expand a Y800 buffer into the bitmap, replicating the gray value in each channel.
+///</summary>
+void PixelConverter::FillFromY800(Bitmap^ _bitmap, Size _size, bool _topDown, array<System::Byte>^ _buffer, int _downscale)
+{
+    BitmapData^ bmpData = LockDestination(_bitmap, _size, _downscale);
+    pin_ptr<System::Byte> pBuffer = &_buffer[0];
+
+    ConvertImage(RowY800ToBGR24, pBuffer, _size.Width, _size.Height, 1, _topDown, (uint8*)bmpData->Scan0.ToPointer(), bmpData->Stride, _downscale);
+
+    _bitmap->UnlockBits(bmpData);
+}
+
+///<summary>
+/// PixelConverter::Expand
+/// Enlarge a reduced image back to the size of the destination bitmap.
+///</summary>
+void PixelConverter::Expand(Bitmap^ _source, Bitmap^ _destination, int _factor)
+{
+    if (_factor < 1 || _source->PixelFormat != PixelFormat::Format24bppRgb || _destination->PixelFormat != PixelFormat::Format24bppRgb)
+        throw gcnew ArgumentException("Bitmaps must be RGB24 and the factor positive.");
+
+    if (_source->Width * _factor < _destination->Width || _source->Height * _factor < _destination->Height)
+        throw gcnew ArgumentException("Source bitmap is too small for the destination.");
+
+    Rectangle srcRect(0, 0, _source->Width, _source->Height);
+    Rectangle dstRect(0, 0, _destination->Width, _destination->Height);
+    BitmapData^ srcData = _source->LockBits(srcRect, ImageLockMode::ReadOnly, _source->PixelFormat);
+    BitmapData^ dstData = _destination->LockBits(dstRect, ImageLockMode::WriteOnly, _destination->PixelFormat);
+
+    ExpandImage((uint8*)srcData->Scan0.ToPointer(), srcData->Stride, (uint8*)dstData->Scan0.ToPointer(), dstRect.Width, dstRect.Height, dstData->Stride, _factor);
+
+    _destination->UnlockBits(dstData);
+    _source->UnlockBits(srcData);
+}
@@ -0,0 +1,63 @@
+#pragma region License
+/*
+Copyright  Joan Charmant 2015.
+joan.charmant@gmail.com
+
+This file is part of Kinovea.
+
+Kinovea is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2
+as published by the Free Software Foundation.
+
+Kinovea is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Kinovea. If not, see http://www.gnu.org/licenses/.
+
+*/
+#pragma endregion
+
+#pragma once
+
+using namespace System;
+using namespace System::Drawing;
+using namespace System::Drawing::Imaging;
+
+namespace Kinovea { namespace Video { namespace FFMpeg
+{
+    /// <summary>
+    /// Conversion of camera images to RGB24 for display.
+    /// Native kernels, vectorized with SSSE3 when the processor supports it.
+    ///
+    /// Source images are expected dense (no row padding), destination stride is taken from the bitmap.
+    /// If topDown is false the source rows are bottom-up and the image is flipped vertically.
+    /// A downscale factor of 2 or 4 produces a smaller image by keeping one pixel out of 2 or 4 in each direction.
+    /// The bitmap must be allocated at the downscaled size, which is the source size divided by the factor, rounded down.
+    /// </summary>
+    public ref class PixelConverter abstract sealed
+    {
+    public:
+        static void FillFromRGB24(Bitmap^ _bitmap, Size _size, bool _topDown, array<System::Byte>^ _buffer, int _downscale);
+        static void FillFromRGB32(Bitmap^ _bitmap, Size _size, bool _topDown, array<System::Byte>^ _buffer, int _downscale);
+        static void FillFromY800(Bitmap^ _bitmap, Size _size, bool _topDown, array<System::Byte>^ _buffer, int _downscale);
+
+        /// <summary>
+        /// Enlarge an RGB24 bitmap into another by an integer factor, replicating pixels.
+        /// The result is cropped to the destination size.
+        /// </summary>
+        static void Expand(Bitmap^ _source, Bitmap^ _destination, int _factor);
+
+        /// <summary>
+        /// Whether the vectorized kernels are used on this machine.
+        /// </summary>
+        static property bool Vectorized {
+            bool get();
+        }
+
+    private:
+        static BitmapData^ LockDestination(Bitmap^ _bitmap, Size _size, int _downscale);
+    };
+}}}
@@ -0,0 +1,356 @@
+/*
+Copyright  Joan Charmant 2015.
+joan.charmant@gmail.com
+
+This file is part of Kinovea.
+
+Kinovea is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2
+as published by the Free Software Foundation.
+
+Kinovea is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Kinovea. If not, see http://www.gnu.org/licenses/.
+
+*/
+
+#include <string.h>
+#include "RawWriter.h"
+
+using namespace System::Diagnostics;
+using namespace System::Drawing;
+using namespace System::IO;
+using namespace System::Runtime::InteropServices;
+
+using namespace Kinovea::Video;
+using namespace Kinovea::Video::FFMpeg;
+
+RawWriter::RawWriter()
+{
+    av_register_all();
+}
+RawWriter::~RawWriter()
+{
+    this->!RawWriter();
+}
+RawWriter::!RawWriter()
+{
+    if (m_pStagingBuffer != nullptr)
+    {
+        av_free(m_pStagingBuffer);
+        m_pStagingBuffer = nullptr;
+    }
+}
+
+///<summary>
+/// RawWriter::OpenSavingContext
+/// Open the output file and write the header. No encoder is involved.
+/// The container is always AVI, its rawvideo flavor is the one best supported for playback.
+///</summary>
+SaveResult RawWriter::OpenSavingContext(String^ _filePath, VideoInfo _info, ImageFormat _inputFormat, double _fFramesInterval)
+{
+    SaveResult result = SaveResult::Success;
+
+    if (m_SavingContext != nullptr)
+        delete m_SavingContext;
+
+    m_SavingContext = gcnew SavingContext();
+    m_InputFormat = _inputFormat;
+    m_iFrameIndex = 0;
+
+    m_SavingContext->pFilePath = static_cast<char*>(Marshal::StringToHGlobalAnsi(_filePath).ToPointer());
+
+    if(!_info.OriginalSize.IsEmpty)
+        m_SavingContext->outputSize = _info.OriginalSize;
+
+    if(_fFramesInterval > 0)
+        m_SavingContext->fFramesInterval = _fFramesInterval;
+
+    do
+    {
+        // 1. Muxer selection.
+        AVOutputFormat* format = av_guess_format("avi", nullptr, nullptr);
+        if (format == nullptr)
+        {
+            result = SaveResult::MuxerNotFound;
+            log->Error("Muxer not found");
+            break;
+        }
+
+        m_SavingContext->pOutputFormat = format;
+
+        // 2. Allocate muxer context.
+        pin_ptr<AVFormatContext*> pinOutputFormatContext = &m_SavingContext->pOutputFormatContext;
+        int averror = avformat_alloc_output_context2(pinOutputFormatContext, format, nullptr, nullptr);
+        if (averror < 0)
+        {
+            result = SaveResult::MuxerParametersNotAllocated;
+            LogError("Muxer parameters object not allocated", averror);
+            break;
+        }
+
+        // 3. Create and describe the video stream.
+        m_SavingContext->pOutputVideoStream = avformat_new_stream(m_SavingContext->pOutputFormatContext, nullptr);
+        if (m_SavingContext->pOutputVideoStream == nullptr)
+        {
+            result = SaveResult::VideoStreamNotCreated;
+            log->Error("Video stream not created");
+            break;
+        }
+
+        if (!SetupStream(m_SavingContext, _inputFormat))
+        {
+            result = SaveResult::EncoderParametersNotSet;
+            log->ErrorFormat("Unsupported input format for raw recording: {0}", _inputFormat);
+            break;
+        }
+
+        // 4. Open the file.
+        // Writes go through a dedicated I/O thread so a slow disk doesn't immediately stall the recording.
+        int64_t bytesPerSecond = (int64_t)(m_iFrameSize * (1000.0 / m_SavingContext->fFramesInterval));
+        m_Output = gcnew WriteBehindFile();
+        if (!m_Output->Open(_filePath, bytesPerSecond))
+        {
+            result = SaveResult::FileNotOpened;
+            log->Error("File not opened");
+            break;
+        }
+
+        m_SavingContext->pOutputFormatContext->pb = m_Output->IOContext;
+
+        // 5. Write file header.
+        averror = avformat_write_header(m_SavingContext->pOutputFormatContext, nullptr);
+        if (averror < 0)
+        {
+            result = SaveResult::FileHeaderNotWritten;
+            LogError("File header not written", averror);
+            break;
+        }
+
+        // 6. Staging buffer for top-down images or unaligned rows.
+        // AVI expects RGB rows bottom-up and padded to 4 bytes.
+        if (m_bFlip || m_iStride != m_iInputStride)
+        {
+            m_pStagingBuffer = (uint8_t*)av_mallocz(m_iFrameSize);
+            if (m_pStagingBuffer == nullptr)
+            {
+                result = SaveResult::InputFrameNotAllocated;
+                log->Error("Staging buffer not allocated");
+                break;
+            }
+        }
+    }
+    while(false);
+
+    return result;
+}
+
+///<summary>
+/// RawWriter::SetupStream
+/// Describe the stored images so that the muxer writes the right BITMAPINFOHEADER.
+///
+/// RGB24 and RGB32 are stored as plain BI_RGB which FFmpeg reads back as bottom-up images.
+/// BI_RGB rows are padded to a multiple of 4 bytes, this only matters for RGB24.
+/// Y800 and I420 use their FourCC and are read back as top-down images.
+///</summary>
+bool RawWriter::SetupStream(SavingContext^ _SavingContext, ImageFormat _inputFormat)
+{
+    AVCodecContext* pCodecContext = _SavingContext->pOutputVideoStream->codec;
+    int width = _SavingContext->outputSize.Width;
+    int height = _SavingContext->outputSize.Height;
+
+    pCodecContext->codec_type = AVMEDIA_TYPE_VIDEO;
+    pCodecContext->codec_id = AV_CODEC_ID_RAWVIDEO;
+    pCodecContext->width = width;
+    pCodecContext->height = height;
+
+    switch (_inputFormat)
+    {
+    case ImageFormat::RGB24:
+        pCodecContext->pix_fmt = AV_PIX_FMT_BGR24;
+        pCodecContext->bits_per_coded_sample = 24;
+        break;
+    case ImageFormat::RGB32:
+        pCodecContext->pix_fmt = AV_PIX_FMT_BGRA;
+        pCodecContext->bits_per_coded_sample = 32;
+        break;
+    case ImageFormat::Y800:
+        pCodecContext->pix_fmt = AV_PIX_FMT_GRAY8;
+        pCodecContext->bits_per_coded_sample = 8;
+        pCodecContext->codec_tag = MKTAG('Y', '8', '0', '0');
+        break;
+    case ImageFormat::I420:
+        pCodecContext->pix_fmt = AV_PIX_FMT_YUV420P;
+        pCodecContext->bits_per_coded_sample = 12;
+        pCodecContext->codec_tag = MKTAG('I', '4', '2', '0');
+        break;
+    case ImageFormat::JPEG:
+        // Samples are already compressed, store them as an MJPEG stream.
+        pCodecContext->codec_id = AV_CODEC_ID_MJPEG;
+        pCodecContext->pix_fmt = AV_PIX_FMT_YUVJ420P;
+        pCodecContext->bits_per_coded_sample = 24;
+        break;
+    default:
+        return false;
+    }
+
+    m_bFlip = _inputFormat == ImageFormat::RGB32;
+    if (_inputFormat == ImageFormat::RGB24 || _inputFormat == ImageFormat::RGB32)
+    {
+        m_iInputStride = width * (pCodecContext->bits_per_coded_sample / 8);
+        m_iStride = (m_iInputStride + 3) & ~3;
+        m_iFrameSize = m_iStride * height;
+    }
+    else
+    {
+        m_iInputStride = 0;
+        m_iStride = 0;
+        m_iFrameSize = _inputFormat == ImageFormat::JPEG ? 0 : avpicture_get_size(pCodecContext->pix_fmt, width, height);
+    }
+
+    // Framerate - timebase.
+    if(_SavingContext->fFramesInterval == 0)
+        _SavingContext->fFramesInterval = 40;
+
+    double fps = 1000 / _SavingContext->fFramesInterval;
+    pCodecContext->time_base.den = (int)Math::Round(1000 * fps);
+    pCodecContext->time_base.num = 1000;
+    _SavingContext->pOutputVideoStream->time_base = pCodecContext->time_base;
+
+    _SavingContext->pOutputVideoStream->id = _SavingContext->pOutputFormatContext->nb_streams - 1;
+    _SavingContext->pOutputFormatContext->video_codec_id = pCodecContext->codec_id;
+
+    return true;
+}
+
+///<summary>
+/// RawWriter::CloseSavingContext
+/// Close the saving context and free any allocated resources.
+///</summary>
+SaveResult RawWriter::CloseSavingContext(bool _bEncodingSuccess)
+{
+    log->Debug("Closing the saving context.");
+
+    if (m_SavingContext == nullptr)
+        return SaveResult::UnknownError;
+
+    if(_bEncodingSuccess)
+        av_write_trailer(m_SavingContext->pOutputFormatContext);
+
+    Marshal::FreeHGlobal(safe_cast<IntPtr>(m_SavingContext->pFilePath));
+
+    if (m_SavingContext->pOutputFormatContext != nullptr)
+    {
+        for(int i = 0; i < (int)m_SavingContext->pOutputFormatContext->nb_streams; i++)
+        {
+            av_freep(&(m_SavingContext->pOutputFormatContext)->streams[i]->codec);
+            av_freep(&(m_SavingContext->pOutputFormatContext)->streams[i]);
+        }
+
+        if (m_Output != nullptr)
+        {
+            m_Output->Close();
+            m_Output = nullptr;
+            m_SavingContext->pOutputFormatContext->pb = nullptr;
+        }
+
+        av_free(m_SavingContext->pOutputFormatContext);
+    }
+
+    if (m_pStagingBuffer != nullptr)
+    {
+        av_free(m_pStagingBuffer);
+        m_pStagingBuffer = nullptr;
+    }
+
+    m_SavingContext = nullptr;
+
+    log->DebugFormat("Raw recording completed. {0} frames written.", m_iFrameIndex);
+
+    return SaveResult::Success;
+}
+
+///<summary>
+/// RawWriter::SaveFrame
+/// Push the frame to the file as is. 
+/// RGB32 images are rewritten to flip them vertically, RGB24 images are rewritten if their rows need padding.
+///</summary>
+SaveResult RawWriter::SaveFrame(ImageFormat format, array<System::Byte>^ buffer, Int64 length)
+{
+    if (format != m_InputFormat)
+    {
+        log->ErrorFormat("Frame format {0} does not match the saving context format {1}", format, m_InputFormat);
+        return SaveResult::UnknownError;
+    }
+
+    int height = m_SavingContext->outputSize.Height;
+    int expected = m_iInputStride > 0 ? m_iInputStride * height : m_iFrameSize;
+    if (format != ImageFormat::JPEG && length < expected)
+    {
+        log->ErrorFormat("Frame is too small. Expected {0} bytes, got {1}.", expected, length);
+        return SaveResult::UnknownError;
+    }
+
+    pin_ptr<uint8_t> pBuffer = &buffer[0];
+    bool written = false;
+
+    if (m_pStagingBuffer != nullptr)
+    {
+        // The padding bytes at the end of each row stay zero.
+        for (int i = 0; i < height; i++)
+        {
+            int source = m_bFlip ? height - 1 - i : i;
+            memcpy(m_pStagingBuffer + (i * m_iStride), pBuffer + (source * m_iInputStride), m_iInputStride);
+        }
+
+        written = WriteFrame(m_iFrameSize, m_SavingContext, m_pStagingBuffer);
+    }
+    else
+    {
+        int size = format == ImageFormat::JPEG ? (int)length : m_iFrameSize;
+        written = WriteFrame(size, m_SavingContext, pBuffer);
+    }
+
+    return written ? SaveResult::Success : SaveResult::UnknownError;
+}
+
+///<summary>
+/// RawWriter::WriteFrame
+/// Commit a single frame in the video file.
+///</summary>
+bool RawWriter::WriteFrame(int _iSize, SavingContext^ _SavingContext, uint8_t* _pBuffer)
+{
+    AVStream* pStream = _SavingContext->pOutputVideoStream;
+
+    AVPacket OutputPacket;
+    av_init_packet(&OutputPacket);
+
+    OutputPacket.stream_index = pStream->index;
+    OutputPacket.flags |= AV_PKT_FLAG_KEY;
+    OutputPacket.data = _pBuffer;
+    OutputPacket.size = _iSize;
+    OutputPacket.pts = av_rescale_q(m_iFrameIndex, pStream->codec->time_base, pStream->time_base);
+    OutputPacket.dts = OutputPacket.pts;
+
+    int averror = av_write_frame(_SavingContext->pOutputFormatContext, &OutputPacket);
+    if (averror < 0)
+    {
+        LogError("Frame not written", averror);
+        return false;
+    }
+
+    m_iFrameIndex++;
+    return true;
+}
+
+void RawWriter::LogError(String^ context, int error)
+{
+    char errbuf[256];
+    av_strerror(error, errbuf, sizeof(errbuf));
+    String^ message = Marshal::PtrToStringAnsi((IntPtr)errbuf);
+    log->Error(String::Format("{0}, Error:{1}", context, message));
+}
@@ -0,0 +1,99 @@
+#pragma region License
+/*
+Copyright  Joan Charmant 2015.
+joan.charmant@gmail.com
+
+This file is part of Kinovea.
+
+Kinovea is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2
+as published by the Free Software Foundation.
+
+Kinovea is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Kinovea. If not, see http://www.gnu.org/licenses/.
+
+*/
+#pragma endregion
+
+#pragma once
+
+extern "C"
+{
+#define __STDC_CONSTANT_MACROS
+#define __STDC_LIMIT_MACROS
+#include <avformat.h>
+#include <avcodec.h>
+#include <avstring.h>
+}
+
+#include "SavingContext.h"
+#include "WriteBehindFile.h"
+
+using namespace System;
+using namespace System::Collections::Generic;
+using namespace System::Diagnostics;
+using namespace System::Drawing;
+using namespace System::IO;
+using namespace System::Reflection;
+using namespace Kinovea::Video;
+
+namespace Kinovea { namespace Video { namespace FFMpeg
+{
+    /// <summary>
+    /// Write camera frames to an AVI file without any encoding.
+    /// Used for high speed recording when even JPEG compression can't keep up with the camera.
+    /// Uncompressed images are stored as rawvideo, JPEG images are stored as MJPEG samples as is.
+    /// The resulting file can be played back by VideoReaderFFMpeg or transcoded after the fact.
+    /// </summary>
+    public ref class RawWriter
+    {
+    // Construction/Destruction
+    public:
+        RawWriter();
+        ~RawWriter();
+    protected:
+        !RawWriter();
+
+    // Public Methods
+    public:
+        SaveResult OpenSavingContext(String^ _FilePath, VideoInfo _info, ImageFormat _inputFormat, double _fFramesInterval);
+        SaveResult CloseSavingContext(bool _bEncodingSuccess);
+        SaveResult SaveFrame(ImageFormat format, array<System::Byte>^ buffer, Int64 length);
+
+    // Properties
+    public:
+        /// <summary>Number of chunks waiting to be written to disk.</summary>
+        property int WriteQueueDepth {
+            int get() { return m_Output == nullptr ? 0 : m_Output->QueueDepth; }
+        }
+
+        /// <summary>Average time spent in a single disk write, in milliseconds.</summary>
+        property double WriteLatency {
+            double get() { return m_Output == nullptr ? 0 : m_Output->AverageWriteLatency; }
+        }
+
+    // Private Methods
+    private:
+        bool SetupStream(SavingContext^ _SavingContext, ImageFormat _inputFormat);
+        bool WriteFrame(int _iSize, SavingContext^ _SavingContext, uint8_t* _pBuffer);
+        void LogError(String^ context, int ffmpegError);
+
+    // Members
+    private :
+        static log4net::ILog^ log = log4net::LogManager::GetLogger(MethodBase::GetCurrentMethod()->DeclaringType);
+        SavingContext^ m_SavingContext;
+        WriteBehindFile^ m_Output;
+        ImageFormat m_InputFormat;
+        int m_iFrameSize;               // Size of an uncompressed frame in the file, in bytes.
+        int m_iInputStride;             // Row size of the incoming images, in bytes.
+        int m_iStride;                  // Row size in the file, padded to 4 bytes for BI_RGB images.
+        bool m_bFlip;                   // Incoming images are top-down and must be flipped vertically.
+        uint8_t* m_pStagingBuffer;      // Staging buffer for images that must be flipped or padded.
+        int64_t m_iFrameIndex;
+    };
+}}}
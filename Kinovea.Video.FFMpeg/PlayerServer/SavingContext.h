@@ -20,6 +20,8 @@ along with Kinovea. If not, see http://www.gnu.org/licenses/.
 
 #pragma once
 
+#include "EncodingContext.h"
+
 using namespace System::Drawing;
 
 namespace Kinovea { namespace Video { namespace FFMpeg
@@ -40,6 +42,7 @@ namespace Kinovea { namespace Video { namespace FFMpeg
 		AVStream* pOutputVideoStream;			// Ouput stream for frames.
 		AVStream* pOutputDataStream;			// Output stream for meta data.
 		AVFrame* pInputFrame;					// The current incoming frame.
+		EncodingContext^ encodingContext;		// Conversion and encoding resources for synchronous encoding.
 		
 		double fPixelAspectRatio;				// Used to adapt pixel aspect ratio.
 		bool bInputWasMpeg2;					
@@ -0,0 +1,352 @@
+/*
+Copyright  Joan Charmant 2015.
+joan.charmant@gmail.com
+
+This file is part of Kinovea.
+
+Kinovea is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2
+as published by the Free Software Foundation.
+
+Kinovea is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Kinovea. If not, see http://www.gnu.org/licenses/.
+
+*/
+
+#include "SyntheticClipGenerator.h"
+
+using namespace Kinovea::Video::FFMpeg;
+
+#pragma managed(push, off)
+
+typedef unsigned char uint8;
+
+///<summary>
+/// Fill a planar 4:2:0 image with the pattern for the given frame.
+/// Luma: diagonal gradient scrolling to the right, a 64px block moving across the image, 
+/// and the barcode on the first row of macroblocks. Chroma: horizontal bands, neutral under the barcode.
+///</summary>
+static void FillPattern(uint8* planes[], int strides[], int width, int height, int frame, int bits, int blockSize)
+{
+    int blockX = (frame * 7) % (width - 64);
+    int blockY = blockSize + ((frame * 5) % (height - 64 - blockSize));
+
+    for (int y = 0; y < height; y++)
+    {
+        uint8* row = planes[0] + (y * strides[0]);
+        for (int x = 0; x < width; x++)
+        {
+            uint8 value;
+            if (y < blockSize)
+            {
+                int bit = x / blockSize;
+                bool set = bit < bits && ((frame >> (bits - 1 - bit)) & 1) != 0;
+                value = set ? 235 : 16;
+            }
+            else
+            {
+                value = (uint8)((x + y - (frame * 3)) & 0xFF);
+                if (x >= blockX && x < blockX + 64 && y >= blockY && y < blockY + 64)
+                    value = 255 - value;
+            }
+
+            row[x] = value;
+        }
+    }
+
+    for (int y = 0; y < height / 2; y++)
+    {
+        uint8* rowU = planes[1] + (y * strides[1]);
+        uint8* rowV = planes[2] + (y * strides[2]);
+        for (int x = 0; x < width / 2; x++)
+        {
+            if (y < blockSize / 2)
+            {
+                rowU[x] = 128;
+                rowV[x] = 128;
+            }
+            else
+            {
+                rowU[x] = (uint8)(96 + (((x + frame) / 8) % 64));
+                rowV[x] = (uint8)(96 + ((y / 8) % 64));
+            }
+        }
+    }
+}
+
+#pragma managed(pop)
+
+bool SyntheticClipGenerator::IsEncoderAvailable(String^ _encoder)
+{
+    av_register_all();
+    char* pEncoder = static_cast<char*>(Marshal::StringToHGlobalAnsi(_encoder).ToPointer());
+    AVCodec* pCodec = avcodec_find_encoder_by_name(pEncoder);
+    Marshal::FreeHGlobal(safe_cast<IntPtr>(pEncoder));
+    return pCodec != nullptr;
+}
+
+///<summary>
+/// SyntheticClipGenerator::Generate
+/// Encode a clip of the given number of frames.
+/// _gopSize is the distance between keyframes, 0 for intra only. _maxBFrames is ignored by intra only encoders.
+///</summary>
+bool SyntheticClipGenerator::Generate(String^ _filePath, String^ _encoder, Size _size, int _frames, int _framerate, int _gopSize, int _maxBFrames)
+{
+    if (_size.Width < MinWidth || _size.Height < 128 || (_size.Width % 2) != 0 || (_size.Height % 2) != 0)
+    {
+        log->ErrorFormat("Unsupported size for synthetic clip: {0}x{1}.", _size.Width, _size.Height);
+        return false;
+    }
+
+    if (_frames <= 0 || _frames > MaxFrames)
+    {
+        log->ErrorFormat("Unsupported frame count for synthetic clip: {0}. The barcode holds at most {1} frames.", _frames, MaxFrames);
+        return false;
+    }
+
+    av_register_all();
+
+    bool generated = false;
+    char* pFilePath = static_cast<char*>(Marshal::StringToHGlobalAnsi(_filePath).ToPointer());
+    char* pEncoder = static_cast<char*>(Marshal::StringToHGlobalAnsi(_encoder).ToPointer());
+
+    AVFormatContext* pFormatCtx = nullptr;
+    AVStream* pStream = nullptr;
+    AVFrame* pFrame = nullptr;
+    uint8_t* pFrameBuffer = nullptr;
+    uint8_t* pOutputBuffer = nullptr;
+    bool bEncoderOpened = false;
+    bool bFileOpened = false;
+    bool bHeaderWritten = false;
+
+    do
+    {
+        // 1. Muxer from file extension.
+        int averror = avformat_alloc_output_context2(&pFormatCtx, nullptr, nullptr, pFilePath);
+        if (averror < 0)
+        {
+            LogError("Muxer not allocated", averror);
+            break;
+        }
+
+        // 2. Encoder.
+        AVCodec* pCodec = avcodec_find_encoder_by_name(pEncoder);
+        if (pCodec == nullptr)
+        {
+            log->ErrorFormat("Encoder not found: {0}.", _encoder);
+            break;
+        }
+
+        pStream = avformat_new_stream(pFormatCtx, pCodec);
+        if (pStream == nullptr)
+        {
+            log->Error("Video stream not created");
+            break;
+        }
+
+        AVCodecContext* pCodecCtx = pStream->codec;
+        avcodec_get_context_defaults3(pCodecCtx, pCodec);
+        pCodecCtx->codec_id = pCodec->id;
+        pCodecCtx->codec_type = AVMEDIA_TYPE_VIDEO;
+        pCodecCtx->width = _size.Width;
+        pCodecCtx->height = _size.Height;
+        pCodecCtx->time_base.num = 1;
+        pCodecCtx->time_base.den = _framerate;
+        pCodecCtx->gop_size = _gopSize;
+        pCodecCtx->max_b_frames = _maxBFrames;
+        
+        // MJPEG only takes full range.
+        pCodecCtx->pix_fmt = pCodec->id == AV_CODEC_ID_MJPEG ? AV_PIX_FMT_YUVJ420P : AV_PIX_FMT_YUV420P;
+        
+        // About 1 bit per pixel, enough to keep the barcode readable.
+        pCodecCtx->bit_rate = _size.Width * _size.Height * _framerate;
+        pCodecCtx->strict_std_compliance = FF_COMPLIANCE_UNOFFICIAL;
+        pStream->time_base = pCodecCtx->time_base;
+
+        if (pFormatCtx->oformat->flags & AVFMT_GLOBALHEADER)
+            pCodecCtx->flags |= CODEC_FLAG_GLOBAL_HEADER;
+
+        averror = avcodec_open2(pCodecCtx, pCodec, nullptr);
+        if (averror < 0)
+        {
+            LogError("Encoder not opened", averror);
+            break;
+        }
+
+        bEncoderOpened = true;
+
+        // 3. File.
+        averror = avio_open(&pFormatCtx->pb, pFilePath, AVIO_FLAG_WRITE);
+        if (averror < 0)
+        {
+            LogError("File not opened", averror);
+            break;
+        }
+
+        bFileOpened = true;
+
+        averror = avformat_write_header(pFormatCtx, nullptr);
+        if (averror < 0)
+        {
+            LogError("File header not written", averror);
+            break;
+        }
+
+        bHeaderWritten = true;
+
+        // 4. Buffers.
+        if ((pFrame = av_frame_alloc()) == nullptr)
+        {
+            log->Error("Frame not allocated");
+            break;
+        }
+
+        pFrameBuffer = (uint8_t*)av_malloc(avpicture_get_size(pCodecCtx->pix_fmt, _size.Width, _size.Height));
+        int iOutputBufferSize = Math::Max(4 * _size.Width * _size.Height, FF_MIN_BUFFER_SIZE);
+        pOutputBuffer = (uint8_t*)av_malloc(iOutputBufferSize);
+        if (pFrameBuffer == nullptr || pOutputBuffer == nullptr)
+        {
+            log->Error("Buffers not allocated");
+            break;
+        }
+
+        avpicture_fill((AVPicture*)pFrame, pFrameBuffer, pCodecCtx->pix_fmt, _size.Width, _size.Height);
+
+        // 5. Encode.
+        bool bFailed = false;
+        for (int i = 0; i < _frames && !bFailed; i++)
+        {
+            FillPattern(pFrame->data, pFrame->linesize, _size.Width, _size.Height, i, m_iBarcodeBits, m_iBarcodeBlockSize);
+            pFrame->pts = i;
+
+            int iEncodedSize = avcodec_encode_video(pCodecCtx, pOutputBuffer, iOutputBufferSize, pFrame);
+            bFailed = !WritePacket(pFormatCtx, pStream, pOutputBuffer, iEncodedSize);
+        }
+
+        // Flush the frames held back by the encoder for B-frames reordering.
+        while (!bFailed)
+        {
+            int iEncodedSize = avcodec_encode_video(pCodecCtx, pOutputBuffer, iOutputBufferSize, nullptr);
+            if (iEncodedSize <= 0)
+                break;
+
+            bFailed = !WritePacket(pFormatCtx, pStream, pOutputBuffer, iEncodedSize);
+        }
+
+        if (bFailed)
+        {
+            log->Error("Error while encoding the synthetic clip.");
+            break;
+        }
+
+        generated = true;
+    }
+    while(false);
+
+    if (bHeaderWritten)
+        av_write_trailer(pFormatCtx);
+
+    if (bEncoderOpened)
+        avcodec_close(pStream->codec);
+
+    if (pFrame != nullptr)
+        av_free(pFrame);
+
+    if (pFrameBuffer != nullptr)
+        av_free(pFrameBuffer);
+
+    if (pOutputBuffer != nullptr)
+        av_free(pOutputBuffer);
+
+    if (bFileOpened)
+        avio_close(pFormatCtx->pb);
+
+    if (pFormatCtx != nullptr)
+        avformat_free_context(pFormatCtx);
+
+    Marshal::FreeHGlobal(safe_cast<IntPtr>(pFilePath));
+    Marshal::FreeHGlobal(safe_cast<IntPtr>(pEncoder));
+
+    return generated;
+}
+
+///<summary>
+/// SyntheticClipGenerator::ReadFrameNumber
+/// Sample the center of each barcode block. Bits are stored most significant first.
+///</summary>
+int SyntheticClipGenerator::ReadFrameNumber(Bitmap^ _image, Size _clipSize)
+{
+    if (_image == nullptr || _clipSize.Width < MinWidth)
+        return -1;
+
+    double scaleX = (double)_image->Width / _clipSize.Width;
+    double scaleY = (double)_image->Height / _clipSize.Height;
+    int y = (int)((m_iBarcodeBlockSize / 2) * scaleY);
+
+    int frame = 0;
+    for (int bit = 0; bit < m_iBarcodeBits; bit++)
+    {
+        int x = (int)(((bit * m_iBarcodeBlockSize) + (m_iBarcodeBlockSize / 2)) * scaleX);
+        Color color = _image->GetPixel(x, y);
+        int luma = (color.R + color.G + color.B) / 3;
+        
+        // Readings in the middle of the range means the frame is corrupted.
+        if (luma > 96 && luma < 160)
+            return -1;
+
+        frame = (frame << 1) | (luma >= 128 ? 1 : 0);
+    }
+
+    return frame;
+}
+
+///<summary>
+/// SyntheticClipGenerator::WritePacket
+/// Mux an encoded frame. A size of zero means the encoder is holding the frame back, not an error.
+///</summary>
+bool SyntheticClipGenerator::WritePacket(AVFormatContext* _pFormatCtx, AVStream* _pStream, uint8_t* _pBuffer, int _iEncodedSize)
+{
+    if (_iEncodedSize < 0)
+        return false;
+
+    if (_iEncodedSize == 0)
+        return true;
+
+    AVCodecContext* pCodecCtx = _pStream->codec;
+
+    AVPacket packet;
+    av_init_packet(&packet);
+
+    // The dts is left to the muxer, which derives it from the pts and the codec reordering delay.
+    if (pCodecCtx->coded_frame->pts != AV_NOPTS_VALUE)
+        packet.pts = av_rescale_q(pCodecCtx->coded_frame->pts, pCodecCtx->time_base, _pStream->time_base);
+
+    if (pCodecCtx->coded_frame->key_frame)
+        packet.flags |= AV_PKT_FLAG_KEY;
+
+    packet.stream_index = _pStream->index;
+    packet.data = _pBuffer;
+    packet.size = _iEncodedSize;
+
+    int averror = av_interleaved_write_frame(_pFormatCtx, &packet);
+    if (averror < 0)
+    {
+        LogError("Packet not written", averror);
+        return false;
+    }
+
+    return true;
+}
+
+void SyntheticClipGenerator::LogError(String^ context, int error)
+{
+    char errbuf[256];
+    av_strerror(error, errbuf, sizeof(errbuf));
+    String^ message = Marshal::PtrToStringAnsi((IntPtr)errbuf);
+    log->Error(String::Format("{0}, Error:{1}", context, message));
+}
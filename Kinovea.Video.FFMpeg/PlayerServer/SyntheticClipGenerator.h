@@ -0,0 +1,72 @@
+#pragma region License
+/*
+Copyright  Joan Charmant 2015.
+joan.charmant@gmail.com
+
+This file is part of Kinovea.
+
+Kinovea is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2
+as published by the Free Software Foundation.
+
+Kinovea is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Kinovea. If not, see http://www.gnu.org/licenses/.
+
+*/
+#pragma endregion
+
+#pragma once
+
+extern "C"
+{
+#define __STDC_CONSTANT_MACROS
+#define __STDC_LIMIT_MACROS
+#include <avformat.h>
+#include <avcodec.h>
+}
+
+using namespace System;
+using namespace System::Drawing;
+using namespace System::Reflection;
+using namespace System::Runtime::InteropServices;
+
+namespace Kinovea { namespace Video { namespace FFMpeg
+{
+    /// <summary>
+    /// Encodes synthetic clips used by the decoding benchmarks.
+    /// The content is a scrolling pattern with a moving block so that inter frames are not trivial.
+    /// The frame number is stamped on the first row of macroblocks as a 16-bit barcode, see ReadFrameNumber.
+    /// The container is selected from the file extension, the encoder by name (mpeg4, mjpeg, libx264, etc.).
+    /// </summary>
+    public ref class SyntheticClipGenerator abstract sealed
+    {
+    public:
+        static bool IsEncoderAvailable(String^ _encoder);
+        static bool Generate(String^ _filePath, String^ _encoder, Size _size, int _frames, int _framerate, int _gopSize, int _maxBFrames);
+
+        /// <summary>
+        /// Read back the frame number stamped on a decoded image, or -1 if the barcode is not readable.
+        /// The image may be at a different size than the clip.
+        /// </summary>
+        static int ReadFrameNumber(Bitmap^ _image, Size _clipSize);
+
+        /// <summary>Minimum width of a clip for the barcode to fit.</summary>
+        static const int MinWidth = 256;
+
+        /// <summary>Maximum number of frames in a clip, past this the 16-bit barcode would wrap around.</summary>
+        static const int MaxFrames = 1 << 16;
+
+    private:
+        static bool WritePacket(AVFormatContext* _pFormatCtx, AVStream* _pStream, uint8_t* _pBuffer, int _iEncodedSize);
+        static void LogError(String^ context, int error);
+
+        static const int m_iBarcodeBits = 16;
+        static const int m_iBarcodeBlockSize = 16;
+        static log4net::ILog^ log = log4net::LogManager::GetLogger(MethodBase::GetCurrentMethod()->DeclaringType);
+    };
+}}}
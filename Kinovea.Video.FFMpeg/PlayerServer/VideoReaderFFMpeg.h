@@ -56,6 +56,8 @@ extern "C" {
 #include <buffersink.h>
 #include <avformat.h>
 #include <avutil.h>
+#include <imgutils.h>
+#include <pixdesc.h>
 #include <postprocess.h>
 #include <swresample.h>
 #include <swscale.h>
@@ -64,8 +66,10 @@ extern "C" {
 #include "ReadResult.h"
 #include "TimestampInfo.h"
 #include "SavingContext.h"
+#include "DecodeTrace.h"
 
 using namespace System;
+using namespace System::Collections::Generic;
 using namespace System::ComponentModel;
 using namespace System::Reflection;
 using namespace System::Threading;
@@ -78,6 +82,42 @@ using namespace Kinovea::Video;
 
 namespace Kinovea { namespace Video { namespace FFMpeg
 {
+    enum class DecodeCommandType
+    {
+        Seek,           // Out of segment jump.
+        Step,           // Move forward faster than the read-ahead.
+        Resize,         // Change the decoding size.
+        ChangeZone,     // Change the working zone.
+        Pause,          // Stop reading ahead.
+        Resume,         // Start reading ahead.
+        Exit
+    };
+
+    /// <summary>
+    /// A request to the decoding thread.
+    /// The result and the timestamp landed on are filled in before the request is marked done.
+    /// </summary>
+    ref class DecodeCommand
+    {
+    public:
+        DecodeCommandType Type;
+        int64_t Timestamp;              // Seek, Resize, Resume. -1 if none.
+        int Frames;                     // Step.
+        Size DecodingSize;              // Resize.
+        Rectangle Region;               // Resize. Empty for the whole picture.
+        VideoSection Zone;              // ChangeZone.
+        ReadResult Result;
+        bool Done;
+
+        DecodeCommand(DecodeCommandType _type)
+        {
+            Type = _type;
+            Timestamp = -1;
+            Frames = 1;
+            Result = ReadResult::FrameNotRead;
+        }
+    };
+
     [SupportedExtensions(
         ".3gp;.asf;.avi;.dv;.flv;.f4v;\
         .m1v;.m2p;.m2t;.m2ts;.mts;.m2v;.m4v;.ts;.ts1;.ts2;.avr;\
@@ -125,6 +165,11 @@ namespace Kinovea { namespace Video { namespace FFMpeg
                     return VideoSection::Empty; 
             }
         }
+        virtual property Kinovea::Video::FrameIndex^ FrameIndex {
+            Kinovea::Video::FrameIndex^ get() override {
+                return m_DecodingMode == VideoDecodingMode::Caching ? m_Cache->Index : nullptr;
+            }
+        }
         virtual property VideoFrame^ Current {
             VideoFrame^ get() override { 
                 return m_FramesContainer != nullptr ? m_FramesContainer->CurrentFrame : nullptr; 
@@ -140,6 +185,33 @@ namespace Kinovea { namespace Video { namespace FFMpeg
                 return m_CanDrawUnscaled;
             }
         }
+        virtual property Rectangle DecodingRegion {
+            Rectangle get() override {
+                return m_DecodingRegion;
+            }
+        }
+        virtual property System::Drawing::Imaging::PixelFormat DecodingPixelFormat {
+            System::Drawing::Imaging::PixelFormat get() override {
+                return m_bGrayscale ? System::Drawing::Imaging::PixelFormat::Format8bppIndexed : System::Drawing::Imaging::PixelFormat::Format32bppPArgb;
+            }
+        }
+        virtual property bool CanSeekAsync {
+            bool get() override {
+                return m_bIsLoaded && (m_DecodingMode == VideoDecodingMode::OnDemand || m_DecodingMode == VideoDecodingMode::PreBuffering);
+            }
+        }
+        virtual property bool RefiningVideoInfo {
+            bool get() override {
+                return m_AnalysisThread != nullptr;
+            }
+        }
+
+    // Properties (FFMpeg specific).
+    public:
+        /// <summary>Timing trace of the decoding stages, disabled by default.</summary>
+        property DecodeTrace^ Trace {
+            DecodeTrace^ get() { return m_Trace; }
+        }
 
     // Public Methods (VideoReader subclassing).
     public:
@@ -154,11 +226,16 @@ namespace Kinovea { namespace Video { namespace FFMpeg
         virtual bool ChangeDeinterlace(bool _deint) override;
         virtual void ChangeDecodingSize(Size _size) override;
         virtual void DisableCustomDecodingSize() override;
+        virtual void ChangeDecodingRegion(Rectangle _region, Size _size) override;
         virtual void BeforePlayloop() override;
         virtual void BeforeFrameEnumeration() override;
         virtual void AfterFrameEnumeration() override;
         virtual void UpdateWorkingZone(VideoSection _newZone, bool _forceReload, int _maxSeconds, int _maxMemory, Action<DoWorkEventHandler^>^ _workerFn) override;
         virtual void ResetDrops() override;
+        virtual bool SeekAsync(int64_t _timestamp) override;
+        virtual bool ApplyAsyncSeek() override;
+        virtual void EndSeekAsync() override;
+        virtual bool ApplyVideoInfoRefinement() override;
 
     // Construction / Destruction.
     public:
@@ -178,10 +255,10 @@ namespace Kinovea { namespace Video { namespace FFMpeg
         VideoInfo m_VideoInfo;
         VideoSection m_WorkingZone;
         Object^ m_Locker;
-        ThreadCanceler^ m_PreBufferingThreadCanceler;
         VideoSection m_SectionToCache;
         bool m_Prepend;
         Size m_DecodingSize;
+        Rectangle m_DecodingRegion;         // Part of the picture converted, in aspect ratio size coordinates. Empty for all.
         bool m_CanDrawUnscaled;
 
         // Frame containers
@@ -198,13 +275,51 @@ namespace Kinovea { namespace Video { namespace FFMpeg
         AVFormatContext* m_pFormatCtx;
         AVCodecContext* m_pCodecCtx;
         TimestampInfo m_TimestampInfo;
-        static const enum AVPixelFormat m_PixelFormatFFmpeg = AV_PIX_FMT_BGRA;
+        int m_iLowres;                      // Codec resolution reduction, the picture is decoded at 1/2^n of its size.
+        static const int MaxLowres = 3;
+        enum AVPixelFormat m_PixelFormatFFmpeg;
+        bool m_bGrayscale;                  // Monochrome source, decoded to 8 bpp gray instead of BGRA.
         static const int DecodingQuality = SWS_FAST_BILINEAR;
+        static const int MonochromeSamples = 5;             // Pictures checked for neutral chroma before decoding a YUV source to gray.
+        static const int MonochromeMaxPackets = 250;
 
         // Others
         bool m_WasPrebuffering;
+        static const int FirstFrameTimeoutMilliseconds = 500;
         LoopWatcher^ m_LoopWatcher;
-        Thread^ m_PreBufferingThread;
+        DecodeTrace^ m_Trace;
+
+        // Decoding thread.
+        Thread^ m_DecodingThread;
+        Object^ m_CommandLocker;
+        Queue<DecodeCommand^>^ m_Commands;  // Guarded by m_CommandLocker, as the two fields below.
+        bool m_bReadAhead;
+        int64_t m_iSeekTarget;              // Pending asynchronous seek, -1 if none.
+
+        // Loop decoder. A second demuxer and decoder, pre-rolled at the start of the working zone, or filling backwards. Decoding thread only.
+        AVFormatContext* m_pLoopFormatCtx;
+        AVCodecContext* m_pLoopCodecCtx;
+        TimestampInfo m_LoopTimestampInfo;
+        FrameRun^ m_LoopHead;
+        int64_t m_iLoopHeadStart;
+        bool m_bLoopDecoderFailed;
+        static const int LoopHeadFrames = 4;
+        FrameRun^ m_BackwardRun;            // Frames before the prebuffered segment, when stepping backwards.
+        bool m_bResyncReadAhead;            // Frames were dropped at the end of the prebuffer, read ahead must seek.
+        static const int BackwardRunFrames = 24;
+
+        // Stream analysis. The file is opened with a quick probe, the full analysis may then run in the background.
+        Thread^ m_AnalysisThread;
+        int* m_pAnalysisAbort;              // Polled by the demuxer of the analysis.
+        VideoInfo m_AnalyzedInfo;           // Written by the analysis thread, read after it has been joined.
+        bool m_bAnalysisSucceeded;
+        static const int QuickProbeSize = 256 * 1024;
+        static const int QuickAnalyzeDuration = 500000;    // AV_TIME_BASE units.
+
+        // Asynchronous seeks.
+        HandoffFrame^ m_HandoffFrame;
+        bool m_bSeekSession;                // UI thread only.
+        static const int SeekRestMilliseconds = 100;
         static log4net::ILog^ log = log4net::LogManager::GetLogger(MethodBase::GetCurrentMethod()->DeclaringType);
 
     // Private methods
@@ -213,22 +328,51 @@ namespace Kinovea { namespace Video { namespace FFMpeg
         void DataInit();
         OpenVideoResult Load(String^ _filePath, bool _forSummary);
         ReadResult ReadFrame(int64_t _iTimeStampToSeekTo, int _iFramesToDecode, bool _approximate);
+        ReadResult ReadFrame(int64_t _iTimeStampToSeekTo, int _iFramesToDecode, bool _approximate, IVideoFramesContainer^ _container);
         int SeekTo(int64_t _target);
         void SetTimestampFromPacket(int64_t _dts, int64_t _pts, bool _bDecoded);
         bool RescaleAndConvert(AVFrame* _pOutputFrame, AVFrame* _pInputFrame, int _OutputWidth, int _OutputHeight, int _OutputFmt, bool _bDeinterlace);
+        bool CropToRegion(uint8_t** _ppData, int* _piStride, uint8_t** _ppCropData, int& _width, int& _height);
+        static bool RegionSupported(AVPixelFormat _format);
+        static bool IsLumaOnly(AVPixelFormat _format);
+        static bool CanCheckChroma(AVPixelFormat _format);
+        bool HasMonochromeContent();
+        static bool HasNeutralChroma(AVFrame* _pFrame);
         static void DisposeFrame(VideoFrame^ _frame);
         static int GetStreamIndex(AVFormatContext* _pFormatCtx, int _iCodecType);
+        static OpenVideoResult OpenInput(String^ _filePath, bool _quickProbe, int* _pAbort, AVFormatContext** _ppFormatCtx);
+        static bool HasVideoParameters(AVFormatContext* _pFormatCtx);
+        static bool NeedsFullAnalysis(AVFormatContext* _pFormatCtx, int _iStream);
+        static bool ReadTimingInfo(AVFormatContext* _pFormatCtx, int _iStream, VideoInfo% _info);
+        void StartStreamAnalysis();
+        void StreamAnalysisWorker();
+        bool EndStreamAnalysis(bool _apply);
         void SetAspectRatioSize(ImageAspectRatio _ratio);
+        int GetLowres(Size _target);
+        bool ChangeLowres(int _lowres);
+        bool ReopenCodec(AVCodecContext* _pCodecCtx, int _lowres);
         Size FixSize(Size _size);
         void ResetDecodingSize();
-        void PreBufferingWorker(Object^ _canceler);
         bool WorkingZoneFitsInMemory(VideoSection _newZone, int _maxSeconds, int _maxMemory);
         bool ReadMany(BackgroundWorker^ _bgWorker, VideoSection _section, bool _prepend);
         void SwitchDecodingMode(VideoDecodingMode _mode);
         void SwitchToBestAfterCaching();
         void ImportWorkingZoneToCache(System::Object^ sender,DoWorkEventArgs^ e);
-        void StartPreBuffering();
-        void StopPreBuffering();
+        void StartDecodingThread();
+        void StopDecodingThread();
+        void PostCommand(DecodeCommand^ _command, bool _wait);
+        void PauseReadAhead();
+        void ResumeReadAhead(int64_t _from);
+        void DecodingWorker();
+        void ExecuteCommand(DecodeCommand^ _command);
+        void ReadAhead();
+        void Scrub(int64_t _target);
+        bool OpenLoopDecoder();
+        void CloseLoopDecoder();
+        void SwapDecoders();
+        bool LoopHeadReady();
+        void PrerollLoopHead();
+        void FillBackward(int _frames);
 
         void DumpInfo();
         static void DumpStreamsInfos(AVFormatContext* _pFormatCtx);
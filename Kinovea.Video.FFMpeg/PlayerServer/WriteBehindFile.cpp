@@ -0,0 +1,388 @@
+/*
+Copyright  Joan Charmant 2015.
+joan.charmant@gmail.com
+
+This file is part of Kinovea.
+
+Kinovea is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2
+as published by the Free Software Foundation.
+
+Kinovea is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Kinovea. If not, see http://www.gnu.org/licenses/.
+
+*/
+
+#include <stdio.h>
+#include <errno.h>
+#include <msclr\lock.h>
+#include "WriteBehindFile.h"
+
+using namespace Kinovea::Video::FFMpeg;
+using namespace msclr;
+
+// AVIOContext callbacks. The opaque pointer is a GCHandle to the WriteBehindFile.
+static int WriteBehindFileWrite(void* opaque, uint8_t* buf, int buf_size)
+{
+    WriteBehindFile^ file = (WriteBehindFile^)GCHandle::FromIntPtr(IntPtr(opaque)).Target;
+    return file->Write(buf, buf_size);
+}
+
+static int64_t WriteBehindFileSeek(void* opaque, int64_t offset, int whence)
+{
+    WriteBehindFile^ file = (WriteBehindFile^)GCHandle::FromIntPtr(IntPtr(opaque)).Target;
+    return file->Seek(offset, whence);
+}
+
+WriteBehindFile::WriteBehindFile()
+{
+    m_Pending = gcnew Queue<WriteBehindCommand^>();
+    m_FreeChunks = gcnew Stack<WriteBehindCommand^>();
+    m_Locker = gcnew Object();
+}
+WriteBehindFile::~WriteBehindFile()
+{
+    Release();
+}
+WriteBehindFile::!WriteBehindFile()
+{
+}
+
+///<summary>
+/// WriteBehindFile::Open
+/// Create the file, the AVIOContext and start the I/O thread.
+/// _iExpectedBytesPerSecond is used to size the steps by which the file is extended.
+///</summary>
+bool WriteBehindFile::Open(String^ _filePath, int64_t _iExpectedBytesPerSecond)
+{
+    bool opened = false;
+
+    m_iPosition = 0;
+    m_iSize = 0;
+    m_iAllocated = 0;
+    m_iWrittenEnd = 0;
+    m_bFailed = false;
+    m_bClosing = false;
+    m_iStalls = 0;
+    m_iWrites = 0;
+    m_iWriteTicks = 0;
+    m_iMaxWriteTicks = 0;
+
+    m_iExtent = Math::Min(Math::Max(_iExpectedBytesPerSecond * m_iExtentSeconds, m_iMinExtent), m_iMaxExtent);
+
+    do
+    {
+        try
+        {
+            // No FileStream buffering, the chunks are already large.
+            m_Stream = gcnew FileStream(_filePath, FileMode::Create, FileAccess::Write, FileShare::Read, 1, FileOptions::None);
+            m_Stream->SetLength(m_iExtent);
+            m_iAllocated = m_iExtent;
+        }
+        catch (Exception^ e)
+        {
+            log->ErrorFormat("Output file not created. {0}", e->Message);
+            break;
+        }
+
+        uint8_t* pBuffer = (uint8_t*)av_malloc(m_iChunkSize);
+        if (pBuffer == nullptr)
+        {
+            log->Error("I/O buffer not allocated");
+            break;
+        }
+
+        m_Handle = GCHandle::Alloc(this);
+        m_pIOContext = avio_alloc_context(pBuffer, m_iChunkSize, 1, GCHandle::ToIntPtr(m_Handle).ToPointer(), nullptr, WriteBehindFileWrite, WriteBehindFileSeek);
+        if (m_pIOContext == nullptr)
+        {
+            av_free(pBuffer);
+            log->Error("I/O context not allocated");
+            break;
+        }
+
+        m_IOThread = gcnew Thread(gcnew ThreadStart(this, &WriteBehindFile::IOWorker));
+        m_IOThread->Name = "WriteBehindFile";
+        m_IOThread->IsBackground = true;
+        m_IOThread->Start();
+
+        opened = true;
+    }
+    while(false);
+
+    if (!opened)
+        Release();
+
+    return opened;
+}
+
+///<summary>
+/// WriteBehindFile::Close
+/// Flush the muxer buffer, wait for all the pending chunks to hit the disk and truncate the file to its real size.
+///</summary>
+void WriteBehindFile::Close()
+{
+    if (m_pIOContext != nullptr)
+        avio_flush(m_pIOContext);
+
+    if (m_IOThread != nullptr)
+    {
+        {
+            lock l(m_Locker);
+            m_bClosing = true;
+            Monitor::PulseAll(m_Locker);
+        }
+
+        m_IOThread->Join();
+        m_IOThread = nullptr;
+    }
+
+    if (m_Stream != nullptr)
+    {
+        try
+        {
+            m_Stream->SetLength(m_iWrittenEnd);
+        }
+        catch (Exception^ e)
+        {
+            log->ErrorFormat("Output file not truncated. {0}", e->Message);
+        }
+    }
+
+    log->DebugFormat("Write-behind file closed. {0} writes, average latency: {1:0.000} ms, max latency: {2:0.000} ms, stalls: {3}.",
+        m_iWrites, AverageWriteLatency, MaxWriteLatency, m_iStalls);
+
+    Release();
+}
+
+int WriteBehindFile::QueueDepth::get()
+{
+    lock l(m_Locker);
+    return m_Pending->Count;
+}
+
+double WriteBehindFile::AverageWriteLatency::get()
+{
+    lock l(m_Locker);
+    if (m_iWrites == 0)
+        return 0;
+
+    return ((double)m_iWriteTicks / m_iWrites) * 1000 / Stopwatch::Frequency;
+}
+
+double WriteBehindFile::MaxWriteLatency::get()
+{
+    lock l(m_Locker);
+    return (double)m_iMaxWriteTicks * 1000 / Stopwatch::Frequency;
+}
+
+///<summary>
+/// WriteBehindFile::Write
+/// Called by the muxer through the AVIOContext. Copy the data to the queue and return immediately,
+/// unless the queue is full.
+///</summary>
+int WriteBehindFile::Write(uint8_t* _pBuffer, int _iSize)
+{
+    int written = 0;
+    while (written < _iSize)
+    {
+        WriteBehindCommand^ command = nullptr;
+
+        {
+            lock l(m_Locker);
+            if (m_bFailed)
+                return AVERROR(EIO);
+
+            if (m_FreeChunks->Count == 0 && m_iAllocatedChunks >= m_iQueueCapacity)
+            {
+                m_iStalls++;
+                while (m_FreeChunks->Count == 0 && !m_bFailed)
+                    Monitor::Wait(m_Locker);
+
+                if (m_bFailed)
+                    return AVERROR(EIO);
+            }
+
+            if (m_FreeChunks->Count > 0)
+            {
+                command = m_FreeChunks->Pop();
+            }
+            else
+            {
+                command = gcnew WriteBehindCommand();
+                command->Data = gcnew array<System::Byte>(m_iChunkSize);
+                m_iAllocatedChunks++;
+            }
+        }
+
+        int size = Math::Min(_iSize - written, m_iChunkSize);
+        Marshal::Copy(IntPtr(_pBuffer + written), command->Data, 0, size);
+        command->Size = size;
+        command->SeekPosition = -1;
+        Enqueue(command);
+
+        written += size;
+    }
+
+    m_iPosition += _iSize;
+    m_iSize = Math::Max(m_iSize, m_iPosition);
+    return _iSize;
+}
+
+///<summary>
+/// WriteBehindFile::Seek
+/// Called by the muxer through the AVIOContext, typically to fix up headers when writing the trailer.
+/// The seek is queued and executed in order with the writes.
+///</summary>
+int64_t WriteBehindFile::Seek(int64_t _iOffset, int _iWhence)
+{
+    int64_t target;
+
+    switch (_iWhence & ~AVSEEK_FORCE)
+    {
+    case AVSEEK_SIZE:
+        return m_iSize;
+    case SEEK_SET:
+        target = _iOffset;
+        break;
+    case SEEK_CUR:
+        target = m_iPosition + _iOffset;
+        break;
+    case SEEK_END:
+        target = m_iSize + _iOffset;
+        break;
+    default:
+        return AVERROR(EINVAL);
+    }
+
+    if (target < 0)
+        return AVERROR(EINVAL);
+
+    WriteBehindCommand^ command = gcnew WriteBehindCommand();
+    command->SeekPosition = target;
+    Enqueue(command);
+
+    m_iPosition = target;
+    return target;
+}
+
+void WriteBehindFile::Enqueue(WriteBehindCommand^ _command)
+{
+    lock l(m_Locker);
+    m_Pending->Enqueue(_command);
+    Monitor::PulseAll(m_Locker);
+}
+
+///<summary>
+/// WriteBehindFile::IOWorker
+/// I/O thread. Execute the queued writes and seeks in order until closed and the queue is empty.
+///</summary>
+void WriteBehindFile::IOWorker()
+{
+    while (true)
+    {
+        WriteBehindCommand^ command = nullptr;
+
+        {
+            lock l(m_Locker);
+            while (m_Pending->Count == 0 && !m_bClosing)
+                Monitor::Wait(m_Locker);
+
+            if (m_Pending->Count == 0)
+                break;
+
+            // Leave the command in the queue while it's being executed so it counts in the queue depth.
+            command = m_Pending->Peek();
+        }
+
+        int64_t ticks = 0;
+        bool failed = false;
+
+        if (!m_bFailed)
+        {
+            try
+            {
+                int64_t start = Stopwatch::GetTimestamp();
+                Execute(command);
+                ticks = Stopwatch::GetTimestamp() - start;
+            }
+            catch (Exception^ e)
+            {
+                log->ErrorFormat("Error while writing to the output file. {0}", e->Message);
+                failed = true;
+            }
+        }
+
+        {
+            lock l(m_Locker);
+            m_Pending->Dequeue();
+
+            if (failed)
+                m_bFailed = true;
+
+            if (command->SeekPosition < 0)
+            {
+                m_FreeChunks->Push(command);
+
+                if (!m_bFailed)
+                {
+                    m_iWrites++;
+                    m_iWriteTicks += ticks;
+                    m_iMaxWriteTicks = Math::Max(m_iMaxWriteTicks, ticks);
+                }
+            }
+
+            Monitor::PulseAll(m_Locker);
+        }
+    }
+}
+
+void WriteBehindFile::Execute(WriteBehindCommand^ _command)
+{
+    if (_command->SeekPosition >= 0)
+    {
+        m_Stream->Seek(_command->SeekPosition, SeekOrigin::Begin);
+        return;
+    }
+
+    // Extend the file ahead of the writes.
+    int64_t end = m_Stream->Position + _command->Size;
+    if (end > m_iAllocated)
+    {
+        while (m_iAllocated < end)
+            m_iAllocated += m_iExtent;
+
+        m_Stream->SetLength(m_iAllocated);
+    }
+
+    m_Stream->Write(_command->Data, 0, _command->Size);
+    m_iWrittenEnd = Math::Max(m_iWrittenEnd, m_Stream->Position);
+}
+
+void WriteBehindFile::Release()
+{
+    if (m_pIOContext != nullptr)
+    {
+        av_free(m_pIOContext->buffer);
+        av_free(m_pIOContext);
+        m_pIOContext = nullptr;
+    }
+
+    if (m_Handle.IsAllocated)
+        m_Handle.Free();
+
+    if (m_Stream != nullptr)
+    {
+        m_Stream->Close();
+        m_Stream = nullptr;
+    }
+
+    m_Pending->Clear();
+    m_FreeChunks->Clear();
+    m_iAllocatedChunks = 0;
+}
@@ -0,0 +1,153 @@
+#pragma region License
+/*
+Copyright  Joan Charmant 2015.
+joan.charmant@gmail.com
+
+This file is part of Kinovea.
+
+Kinovea is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2
+as published by the Free Software Foundation.
+
+Kinovea is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Kinovea. If not, see http://www.gnu.org/licenses/.
+
+*/
+#pragma endregion
+
+#pragma once
+
+extern "C"
+{
+#define __STDC_CONSTANT_MACROS
+#define __STDC_LIMIT_MACROS
+#include <avformat.h>
+}
+
+using namespace System;
+using namespace System::Collections::Generic;
+using namespace System::Diagnostics;
+using namespace System::IO;
+using namespace System::Reflection;
+using namespace System::Runtime::InteropServices;
+using namespace System::Threading;
+
+namespace Kinovea { namespace Video { namespace FFMpeg
+{
+    /// <summary>
+    /// A chunk of muxer output waiting to be written to disk, or a seek request.
+    /// </summary>
+    ref class WriteBehindCommand
+    {
+    public:
+        array<System::Byte>^ Data;
+        int Size;
+        int64_t SeekPosition;           // -1 for write commands.
+    };
+
+    /// <summary>
+    /// Output file for the recorders, exposed to the muxer as a custom AVIOContext.
+    /// The muxer output is copied into a bounded queue and written to disk by a dedicated thread,
+    /// so that a slow disk doesn't directly stall the encoding thread.
+    /// The file is extended by large steps ahead of the writes to limit fragmentation and metadata updates,
+    /// and truncated to its real size on close.
+    /// </summary>
+    public ref class WriteBehindFile
+    {
+    // Construction/Destruction
+    public:
+        WriteBehindFile();
+        ~WriteBehindFile();
+    protected:
+        !WriteBehindFile();
+
+    // Public Methods
+    public:
+        bool Open(String^ _filePath, int64_t _iExpectedBytesPerSecond);
+        void Close();
+
+    // Properties
+    public:
+        property AVIOContext* IOContext {
+            AVIOContext* get() { return m_pIOContext; }
+        }
+
+        /// <summary>Number of chunks waiting to be written to disk.</summary>
+        property int QueueDepth {
+            int get();
+        }
+
+        /// <summary>Maximum number of chunks that can be waiting before the muxer is blocked.</summary>
+        property int QueueCapacity {
+            int get() { return m_iQueueCapacity; }
+        }
+
+        /// <summary>Average time spent in a single disk write, in milliseconds.</summary>
+        property double AverageWriteLatency {
+            double get();
+        }
+
+        /// <summary>Longest time spent in a single disk write, in milliseconds.</summary>
+        property double MaxWriteLatency {
+            double get();
+        }
+
+        /// <summary>Number of times the muxer had to wait because the queue was full.</summary>
+        property int Stalls {
+            int get() { return m_iStalls; }
+        }
+
+    // Internal, called from the AVIOContext callbacks.
+    internal:
+        int Write(uint8_t* _pBuffer, int _iSize);
+        int64_t Seek(int64_t _iOffset, int _iWhence);
+
+    // Private Methods
+    private:
+        void Enqueue(WriteBehindCommand^ _command);
+        void IOWorker();
+        void Execute(WriteBehindCommand^ _command);
+        void Release();
+
+    // Members
+    private:
+        static log4net::ILog^ log = log4net::LogManager::GetLogger(MethodBase::GetCurrentMethod()->DeclaringType);
+
+        static const int m_iChunkSize = 1024 * 1024;
+        static const int m_iQueueCapacity = 64;
+        static const int64_t m_iMinExtent = 16 * 1024 * 1024;
+        static const int64_t m_iMaxExtent = 1024 * 1024 * 1024;
+        static const int m_iExtentSeconds = 10;
+
+        AVIOContext* m_pIOContext;
+        GCHandle m_Handle;
+        FileStream^ m_Stream;
+        Thread^ m_IOThread;
+
+        // Muxer side. Only touched from the thread running the muxer.
+        int64_t m_iPosition;
+        int64_t m_iSize;
+
+        // I/O thread side.
+        int64_t m_iExtent;
+        int64_t m_iAllocated;
+        int64_t m_iWrittenEnd;
+        bool m_bFailed;
+
+        // Shared, guarded by m_Locker.
+        Queue<WriteBehindCommand^>^ m_Pending;
+        Stack<WriteBehindCommand^>^ m_FreeChunks;
+        int m_iAllocatedChunks;
+        bool m_bClosing;
+        int m_iStalls;
+        int64_t m_iWrites;
+        int64_t m_iWriteTicks;
+        int64_t m_iMaxWriteTicks;
+        Object^ m_Locker;
+    };
+}}}
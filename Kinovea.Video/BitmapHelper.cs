@@ -11,6 +11,17 @@ namespace Kinovea.Video
 {
     public static class BitmapHelper
     {
+        private static readonly ColorPalette grayscalePalette = CreateGrayscalePalette();
+
+        /// <summary>
+        /// Linear gray palette for 8 bpp indexed images.
+        /// Assigning it to a bitmap copies it, the shared instance is never modified.
+        /// </summary>
+        public static ColorPalette GrayscalePalette
+        {
+            get { return grayscalePalette; }
+        }
+
         /// <summary>
         /// Allocate a new bitmap and copy the passed bitmap into it.
         /// </summary>
@@ -20,6 +31,9 @@ namespace Kinovea.Video
             Rectangle rect = new Rectangle(0, 0, src.Width, src.Height);
 
             Copy(src, dst, rect);
+
+            if ((src.PixelFormat & PixelFormat.Indexed) == PixelFormat.Indexed)
+                dst.Palette = src.Palette;
             
             return dst;
         }
@@ -169,5 +183,18 @@ namespace Kinovea.Video
 
             bitmap.UnlockBits(bmpData);
         }
+
+        private static ColorPalette CreateGrayscalePalette()
+        {
+            // ColorPalette has no public constructor, get one from a bitmap.
+            using (Bitmap bitmap = new Bitmap(1, 1, PixelFormat.Format8bppIndexed))
+            {
+                ColorPalette palette = bitmap.Palette;
+                for (int i = 0; i < 256; i++)
+                    palette.Entries[i] = Color.FromArgb(i, i, i);
+
+                return palette;
+            }
+        }
     }
 }
@@ -39,6 +39,7 @@ namespace Kinovea.Video
         CanChangeFrameRate = 128,
         CanChangeDecodingSize = 256,
         CanScaleIndefinitely = 512,
+        CanDecodeRegion = 1024,
     }
     
     /// <summary>
@@ -52,6 +53,16 @@ namespace Kinovea.Video
         Caching         // All the frames of the working zone have been loaded to a large buffer.
     }
     
+    /// <summary>
+    /// How the play head has been moving recently, used to balance the prebuffer around it.
+    /// </summary>
+    public enum AccessPattern
+    {
+        Forward,        // Playback or stepping forward: read ahead, keep a few frames behind.
+        Backward,       // Stepping backwards: keep most of the frames behind, refill before the segment.
+        Oscillating     // Going back and forth around a point: keep as many frames on each side.
+    }
+    
     public enum ImageAspectRatio
     {
         Auto,
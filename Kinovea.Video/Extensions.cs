@@ -32,13 +32,29 @@ namespace Kinovea.Video
     {
         /// <summary>
         /// Deep clone of a bitmap.
+        /// Indexed images can't be drawn on, they are copied along with their palette.
         /// </summary>
         public static Bitmap CloneDeep(this Bitmap _bmp)
         {
             if(object.ReferenceEquals(_bmp, null))
                 return null;
             
-            Bitmap clone = new Bitmap(_bmp.Width, _bmp.Height, _bmp.PixelFormat);
+            if((_bmp.PixelFormat & PixelFormat.Indexed) == PixelFormat.Indexed)
+                return BitmapHelper.Copy(_bmp);
+            
+            return _bmp.CloneDeep(_bmp.PixelFormat);
+        }
+        
+        /// <summary>
+        /// Deep clone of a bitmap into the given pixel format.
+        /// Use this to get an image that can be drawn on, whatever the source format.
+        /// </summary>
+        public static Bitmap CloneDeep(this Bitmap _bmp, PixelFormat _format)
+        {
+            if(object.ReferenceEquals(_bmp, null))
+                return null;
+            
+            Bitmap clone = new Bitmap(_bmp.Width, _bmp.Height, _format);
             Graphics g = Graphics.FromImage(clone);
             g.DrawImageUnscaled(_bmp, 0, 0);
             return clone;
@@ -46,17 +62,20 @@ namespace Kinovea.Video
         
         /// <summary>
         /// Extract a rectangular region out of a bitmap.
+        /// The template has the pixel format of the image.
         /// </summary>
         public static Bitmap ExtractTemplate(this Bitmap image, Rectangle region)
         {
             // TODO: test perfs by simply drawing in the new image.
             
-            Bitmap template = new Bitmap(region.Width, region.Height, PixelFormat.Format32bppPArgb);
+            Bitmap template = new Bitmap(region.Width, region.Height, image.PixelFormat);
+            if((image.PixelFormat & PixelFormat.Indexed) == PixelFormat.Indexed)
+                template.Palette = image.Palette;
             
             BitmapData imageData = image.LockBits( new Rectangle( 0, 0, image.Width, image.Height ), ImageLockMode.ReadOnly, image.PixelFormat );
             BitmapData templateData = template.LockBits(new Rectangle( 0, 0, template.Width, template.Height ), ImageLockMode.ReadWrite, template.PixelFormat );
                 
-            int pixelSize = 4;
+            int pixelSize = Image.GetPixelFormatSize(image.PixelFormat) / 8;
                 
             int tplStride = templateData.Stride;
             int templateWidthInBytes = region.Width * pixelSize;
@@ -40,10 +40,17 @@ namespace Kinovea.Video
         public VideoSection WorkingZone {
             get { return m_WorkingZone;}
         }
+        /// <summary>
+        /// Timestamps of the cached frames.
+        /// </summary>
+        public FrameIndex Index {
+            get { return m_Index; }
+        }
         #endregion
         
         #region Members
         private List<VideoFrame> m_Frames = new List<VideoFrame>();
+        private FrameIndex m_Index = new FrameIndex();
         private int m_CurrentIndex = -1;
         private VideoFrame m_Current;
         private VideoSection m_WorkingZone = VideoSection.Empty;
@@ -99,7 +106,7 @@ namespace Kinovea.Video
             if( m_Current != null && _timestamp == m_Current.Timestamp)
                 return true;
 
-            m_CurrentIndex = m_Frames.FindIndex(f => f.Timestamp >= _timestamp);
+            m_CurrentIndex = FrameIndex.LowerBound(m_Frames, 0, m_Frames.Count, _timestamp);
             UpdateCurrentFrame();
             return true;
         }
@@ -109,7 +116,8 @@ namespace Kinovea.Video
                 m_Frames.Insert(m_InsertIndex++, _frame);
             else
                 m_Frames.Add(_frame);
-                
+            
+            m_Index.Add(_frame.Timestamp);
             UpdateWorkingZone();
         }
         public void Clear()
@@ -121,6 +129,7 @@ namespace Kinovea.Video
                 DisposeFrame(frame);
                 
             m_Frames.Clear();
+            m_Index.Clear();
             m_WorkingZone = VideoSection.Empty;
         }
         /// <summary>
@@ -150,6 +159,7 @@ namespace Kinovea.Video
                 m_CurrentIndex-=removedAtLeft;
             
             m_Frames.RemoveAll(frame => object.ReferenceEquals(null, frame));
+            m_Index.Reduce(m_WorkingZone);
             
             m_CurrentIndex = Math.Max(0, m_CurrentIndex);
             m_Current = m_Frames[m_CurrentIndex];
@@ -0,0 +1,84 @@
+﻿#region License
+/*
+Copyright © Joan Charmant 2015.
+joan.charmant@gmail.com 
+ 
+This file is part of Kinovea.
+
+Kinovea is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 
+as published by the Free Software Foundation.
+
+Kinovea is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Kinovea. If not, see http://www.gnu.org/licenses/.
+*/
+#endregion
+using System;
+using System.Collections.Generic;
+
+namespace Kinovea.Video
+{
+    /// <summary>
+    /// A short run of consecutive frames decoded outside the prebuffer and handed over to it in one go.
+    /// Used for the start of the working zone, decoded ahead of time so the end of the loop doesn't need a seek,
+    /// and for the frames before the prebuffered segment when stepping backwards.
+    /// Only used by the decoding thread.
+    /// </summary>
+    public class FrameRun : IVideoFramesContainer
+    {
+        public VideoFrame CurrentFrame {
+            get { return m_Frames.Count > 0 ? m_Frames[m_Frames.Count - 1] : null; }
+        }
+        public int Count {
+            get { return m_Frames.Count; }
+        }
+        public bool Full {
+            get { return m_Frames.Count >= m_Capacity; }
+        }
+        
+        #region Members
+        private List<VideoFrame> m_Frames = new List<VideoFrame>();
+        private int m_Capacity;
+        private VideoFrameDisposer m_Disposer;
+        #endregion
+        
+        public FrameRun(int _capacity, VideoFrameDisposer _disposer)
+        {
+            m_Capacity = _capacity;
+            m_Disposer = _disposer;
+        }
+        
+        public void Add(VideoFrame _frame)
+        {
+            m_Frames.Add(_frame);
+        }
+        
+        /// <summary>
+        /// Remove all the frames, in order, without disposing them. The caller takes ownership.
+        /// </summary>
+        public List<VideoFrame> TakeAll()
+        {
+            List<VideoFrame> frames = m_Frames;
+            m_Frames = new List<VideoFrame>();
+            return frames;
+        }
+        
+        public void Clear()
+        {
+            foreach(VideoFrame frame in m_Frames)
+            {
+                if(m_Disposer != null)
+                    m_Disposer(frame);
+                else
+                    frame.Image.Dispose();
+            }
+            
+            m_Frames.Clear();
+        }
+    }
+}
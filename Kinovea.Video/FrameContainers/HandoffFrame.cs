@@ -0,0 +1,112 @@
+﻿#region License
+/*
+Copyright © Joan Charmant 2015.
+joan.charmant@gmail.com 
+ 
+This file is part of Kinovea.
+
+Kinovea is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 
+as published by the Free Software Foundation.
+
+Kinovea is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Kinovea. If not, see http://www.gnu.org/licenses/.
+*/
+#endregion
+using System;
+
+namespace Kinovea.Video
+{
+    /// <summary>
+    /// A single frame container passing frames from a decoding thread to the UI thread.
+    /// The decoding thread adds frames, they are kept pending until the UI thread publishes them.
+    /// A pending frame replaced before being published is disposed right away, it has never been shown.
+    /// The published frame is only disposed by the UI thread, when the next one is published, so it can be drawn without locking.
+    /// </summary>
+    public class HandoffFrame : IVideoFramesContainer
+    {
+        public VideoFrame CurrentFrame {
+            get { return m_Current; }
+        }
+        
+        #region Members
+        private VideoFrame m_Current;
+        private VideoFrame m_Pending;
+        private VideoFrameDisposer m_Disposer;
+        private readonly object m_Locker = new object();
+        #endregion
+        
+        public HandoffFrame(VideoFrameDisposer _disposer)
+        {
+            m_Disposer = _disposer;
+        }
+        
+        /// <summary>
+        /// Called from the decoding thread.
+        /// </summary>
+        public void Add(VideoFrame _frame)
+        {
+            lock(m_Locker)
+            {
+                if(m_Pending != null)
+                    DisposeFrame(m_Pending);
+                
+                m_Pending = _frame;
+            }
+        }
+        
+        /// <summary>
+        /// Make the pending frame current. Called from the UI thread.
+        /// Returns false if there was no pending frame.
+        /// </summary>
+        public bool Publish()
+        {
+            VideoFrame old;
+            lock(m_Locker)
+            {
+                if(m_Pending == null)
+                    return false;
+                
+                old = m_Current;
+                m_Current = m_Pending;
+                m_Pending = null;
+            }
+            
+            if(old != null)
+                DisposeFrame(old);
+            
+            return true;
+        }
+        
+        /// <summary>
+        /// Dispose all frames. Must not be called while the decoding thread is adding frames.
+        /// </summary>
+        public void Clear()
+        {
+            lock(m_Locker)
+            {
+                if(m_Pending != null)
+                    DisposeFrame(m_Pending);
+                
+                if(m_Current != null)
+                    DisposeFrame(m_Current);
+                
+                m_Pending = null;
+                m_Current = null;
+            }
+        }
+        
+        private void DisposeFrame(VideoFrame _frame)
+        {
+            if(m_Disposer != null)
+                m_Disposer(_frame);
+            else
+                _frame.Image.Dispose();
+        }
+    }
+}
@@ -38,6 +38,8 @@ namespace Kinovea.Video
     /// Naming:
     /// - Segment: the section of prebuffered frames, contained inside the working zone.
     /// - OldFramesCapacity: the number of frames kept that are older than the current point.
+    /// - Pattern: forward, backward or oscillating, from the last moves of the play head. It sets the old frames capacity.
+    ///   In the backward and oscillating patterns the decoding thread also fills the buffer before the segment, see Prepend.
     ///
     /// Thread safety:
     /// Locking is necessary around all access to m_Frames as it is read and written by both the UI and the decoding thread.
@@ -45,7 +47,14 @@ namespace Kinovea.Video
     /// This is because m_Frames is only accessed for add by the decoding thread and this has no impact on m_Current reference.
     /// The only thing that alters the reference to m_Current are: MoveNext, MoveTo, PurgeOutsiders, Clear.
     /// All these are initiated by the UI thread itself, so it will not be using m_Current simultaneously.
+    /// The exception is Clear, which the decoding thread may call while executing a command the UI thread is waiting on.
     /// Similarly, drop count is only updated in MoveNext and MoveTo, so only from the UI thread.
+    ///
+    /// When the buffer is full the decoding thread waits inside Add. Interrupt makes it return so it can serve a request,
+    /// Add will not wait again until ResetInterrupt. Moving back close to the start of the segment does the same,
+    /// so the decoding thread can fill before it.
+    ///
+    /// The UI thread may wait for the first frame with WaitForFrame, Add wakes it up.
     ///</remarks>
     public class PreBuffer : IDisposable, IVideoFramesContainer
     {
@@ -59,6 +68,29 @@ namespace Kinovea.Video
         public int Drops { 
             get { return m_Drops; }
         }
+        /// <summary>
+        /// Whether the next Add will wait for room.
+        /// </summary>
+        public bool Full {
+            get { lock(m_Locker) return m_Frames.Count + 1 >= m_TotalCapacity; }
+        }
+        public AccessPattern Pattern {
+            get { return m_Pattern; }
+        }
+        /// <summary>
+        /// Number of frames the decoding thread should decode right before the segment, 0 if none.
+        /// </summary>
+        public int BackwardFillCount {
+            get { 
+                lock(m_Locker)
+                {
+                    if(!NeedsBackwardFill())
+                        return 0;
+                    
+                    return m_OldFramesCapacity - m_CurrentIndex;
+                }
+            }
+        }
         #endregion
         
         #region Members
@@ -74,6 +106,13 @@ namespace Kinovea.Video
         private int m_DefaultOldFramesCapacity = 8;
         private int m_OldFramesCapacity = 8; // Will later be taken from Prefs, possibly in MB instead of frames.
         private int m_Drops;
+        private bool m_Interrupted;
+        private bool m_WaitingForFrame;
+        private AccessPattern m_Pattern = AccessPattern.Forward;
+        private int m_MoveHistory;              // Last moves of the play head, one bit each, set for backward.
+        private long m_BackwardFillStop = -1;   // Segment start from which no earlier frame could be decoded.
+        private const int MoveHistoryLength = 8;
+        private const int MinAheadFrames = 2;   // Frames kept after the current point when making room for older frames.
         private VideoFrameDisposer m_DisposeBitmap;
         private TimeWatcher m_TimeWatcher = new TimeWatcher();
         private static readonly log4net.ILog log = log4net.LogManager.GetLogger(System.Reflection.MethodBase.GetCurrentMethod().DeclaringType);
@@ -125,6 +164,8 @@ namespace Kinovea.Video
                 
                 if(m_CurrentIndex >= 0 && m_CurrentIndex <= lastIndex)
                     m_Current = m_Frames[m_CurrentIndex];
+                
+                RecordMove(false);
             }
             
             // ForgetOldFrames will take another lock, should it be inside the first ?
@@ -145,17 +186,22 @@ namespace Kinovea.Video
 
             lock(m_Locker)
             {
-                foreach(int i in SortedFrames())
-                {
-                    if(m_Frames[i].Timestamp >= _timestamp)
-                    {
-                        m_CurrentIndex = i;
-                        break;
-                    }
-                }
+                if(m_Current != null)
+                    RecordMove(_timestamp < m_Current.Timestamp);
+                
+                int index = FindFrame(_timestamp);
+                if(index >= 0)
+                    m_CurrentIndex = index;
             
                 if(m_CurrentIndex >= 0 && m_CurrentIndex <= m_Frames.Count - 1)
                     m_Current = m_Frames[m_CurrentIndex];
+                
+                // Wake the decoding thread if it is waiting on a full buffer, there is work before the segment.
+                if(NeedsBackwardFill())
+                {
+                    m_Interrupted = true;
+                    Monitor.Pulse(m_Locker);
+                }
             }
             
             ForgetOldFrames();
@@ -178,7 +224,11 @@ namespace Kinovea.Video
                 //log.DebugFormat("Add - Pushing frame [{0}] to prebuffer. ({1}/{2}).", _frame.Timestamp, m_Frames.Count+1, m_TotalCapacity);
                 m_Frames.Add(_frame);
                 UpdateSegment();
-                while (m_Frames.Count >= m_TotalCapacity)
+                
+                if(m_WaitingForFrame)
+                    Monitor.PulseAll(m_Locker);
+                
+                while (m_Frames.Count >= m_TotalCapacity && !m_Interrupted)
                 {
                     // Will release its lock and freeze until there is a pulse.
                     // We do this after the actual Add so the decoding thread, when woken up,
@@ -187,6 +237,101 @@ namespace Kinovea.Video
                 }
             }
         }
+        /// <summary>
+        /// Block until the buffer holds at least one frame, or the timeout expires. Returns false on timeout.
+        /// Used right after read ahead starts, so the first request doesn't interrupt the decoding of the frame it asks for.
+        /// </summary>
+        public bool WaitForFrame(int _timeoutMilliseconds)
+        {
+            Stopwatch stopwatch = Stopwatch.StartNew();
+            lock(m_Locker)
+            {
+                m_WaitingForFrame = true;
+                try
+                {
+                    while(m_Frames.Count == 0)
+                    {
+                        int remaining = _timeoutMilliseconds - (int)stopwatch.ElapsedMilliseconds;
+                        if(remaining <= 0)
+                            return false;
+                        
+                        Monitor.Wait(m_Locker, remaining);
+                    }
+                    
+                    return true;
+                }
+                finally
+                {
+                    m_WaitingForFrame = false;
+                }
+            }
+        }
+        /// <summary>
+        /// Stop asking for frames before the segment while it starts at this timestamp.
+        /// Used when the decoding thread could not get any frame before it, for example when the working zone 
+        /// starts before the first decodable frame.
+        /// </summary>
+        public void StopBackwardFill(long _segmentStart)
+        {
+            lock(m_Locker)
+                m_BackwardFillStop = _segmentStart;
+        }
+        /// <summary>
+        /// Insert frames right before the segment. Called by the decoding thread after a backward fill.
+        /// The frames must be consecutive and end right before the segment start it was given.
+        /// Frames at the end of the buffer are dropped to make room, returns true if this happened,
+        /// the next frame to read ahead is then no longer the one after the last decoded.
+        /// Frames that can't be inserted are disposed.
+        /// </summary>
+        public bool Prepend(List<VideoFrame> _frames, long _segmentStart)
+        {
+            bool trimmed = false;
+            lock(m_Locker)
+            {
+                // Frames at or after the segment start are already in.
+                int count = 0;
+                while(count < _frames.Count && _frames[count].Timestamp < _segmentStart)
+                    count++;
+                
+                // The segment may have moved since the fill started.
+                bool contiguous = m_Frames.Count > 0 && !m_Segment.Wrapped && m_Segment.Start == _segmentStart && m_CurrentIndex >= 0;
+                if(!contiguous)
+                    count = 0;
+                
+                int room = m_TotalCapacity - 1 - m_Frames.Count;
+                if(count > room)
+                {
+                    int trim = Math.Min(count - room, m_Frames.Count - 1 - m_CurrentIndex - MinAheadFrames);
+                    if(trim > 0)
+                    {
+                        for(int i = m_Frames.Count - trim; i < m_Frames.Count; i++)
+                            DisposeFrame(m_Frames[i]);
+                        
+                        m_Frames.RemoveRange(m_Frames.Count - trim, trim);
+                        room += trim;
+                        trimmed = true;
+                    }
+                }
+                
+                // Keep the frames closest to the segment.
+                int first = Math.Max(0, count - Math.Max(0, room));
+                for(int i = 0; i < _frames.Count; i++)
+                {
+                    if(i < first || i >= count)
+                        DisposeFrame(_frames[i]);
+                }
+                
+                if(count > first)
+                {
+                    m_Frames.InsertRange(0, _frames.GetRange(first, count - first));
+                    m_CurrentIndex += count - first;
+                }
+                
+                UpdateSegment();
+            }
+            
+            return trimmed;
+        }
         public bool Contains(long _timestamp)
         {
             lock(m_Locker)
@@ -216,35 +361,29 @@ namespace Kinovea.Video
                 m_CurrentIndex = -1;
                 m_Drops = 0;
                 m_Segment = VideoSection.Empty;
+                m_BackwardFillStop = -1;
                 m_TotalCapacity = m_DefaultTotalCapacity;
-                m_OldFramesCapacity = m_DefaultOldFramesCapacity;
+                m_OldFramesCapacity = GetOldFramesCapacity();
                 
                 Monitor.Pulse(m_Locker);
             }
         }
-        public void UnblockAndMakeRoom()
+        /// <summary>
+        /// Wake the decoding thread if it is waiting on a full buffer, and keep Add from waiting until ResetInterrupt.
+        /// </summary>
+        public void Interrupt()
         {
             lock(m_Locker)
             {
-                // This is used to temporarily deactivate the prebuffering thread without 
-                // completely clearing it. The decoding thread is potentially waiting on a full buffer,
-                // so we must discard at least one frame to make it run again and check for cancellation.
-                // However, the next Add is assumed to run on the UI thread, so it must not block.
-                // So we actually need to have two empty slots: one to push the read,
-                // and one to make that push non-blocking.
-                log.Debug("Unblocking prebuffering thread and making room for a non blocking addition.");
-                
-                while(m_Frames.Count > m_TotalCapacity - 2)
-                {
-                    DisposeFrame(m_Frames[0]);
-                    m_Frames.RemoveAt(0);
-                    m_CurrentIndex--;
-                }
-                UpdateSegment();
-                
+                m_Interrupted = true;
                 Monitor.Pulse(m_Locker);
             }
         }
+        public void ResetInterrupt()
+        {
+            lock(m_Locker)
+                m_Interrupted = false;
+        }
         
         public void UpdateWorkingZone(VideoSection _newZone)
         {
@@ -328,6 +467,67 @@ namespace Kinovea.Video
                 yield return next;
             }
         }
+        private int FindFrame(long _timestamp)
+        {
+            // /!\ Should only be called from inside a lock construct.
+            
+            // Returns the index of the first frame at or after the timestamp, -1 if none.
+            // The frames are two sorted runs when the segment wraps, the run after the wrap comes first in timestamp order.
+            int wrapIndex = GetWrapIndex();
+            
+            int index = FrameIndex.LowerBound(m_Frames, wrapIndex, m_Frames.Count - wrapIndex, _timestamp);
+            if(index < m_Frames.Count)
+                return index;
+            
+            index = FrameIndex.LowerBound(m_Frames, 0, wrapIndex, _timestamp);
+            return index < wrapIndex ? index : -1;
+        }
+        private void RecordMove(bool _backward)
+        {
+            // Always inside a lock.
+            m_MoveHistory = ((m_MoveHistory << 1) | (_backward ? 1 : 0)) & ((1 << MoveHistoryLength) - 1);
+            
+            int backwardMoves = 0;
+            for(int i = 0; i < MoveHistoryLength; i++)
+                backwardMoves += (m_MoveHistory >> i) & 1;
+            
+            // A single step back during playback is not a change of pattern.
+            AccessPattern pattern;
+            if(backwardMoves <= 1)
+                pattern = AccessPattern.Forward;
+            else if(backwardMoves >= MoveHistoryLength - 2)
+                pattern = AccessPattern.Backward;
+            else
+                pattern = AccessPattern.Oscillating;
+            
+            if(pattern == m_Pattern)
+                return;
+            
+            log.DebugFormat("Prebuffer access pattern: {0}.", pattern);
+            m_Pattern = pattern;
+            m_OldFramesCapacity = GetOldFramesCapacity();
+        }
+        private int GetOldFramesCapacity()
+        {
+            switch(m_Pattern)
+            {
+                case AccessPattern.Backward:
+                    return m_TotalCapacity - MinAheadFrames - 2;
+                case AccessPattern.Oscillating:
+                    return m_TotalCapacity / 2;
+                default:
+                    return m_DefaultOldFramesCapacity;
+            }
+        }
+        private bool NeedsBackwardFill()
+        {
+            // Always inside a lock.
+            // Refill once less than half the frames wanted behind the current point are left.
+            if(m_Pattern == AccessPattern.Forward || m_CurrentIndex < 0 || m_Segment.Wrapped || m_Segment.Start == m_BackwardFillStop)
+                return false;
+            
+            return m_CurrentIndex < m_OldFramesCapacity / 2 && m_Segment.Start > m_WorkingZone.Start;
+        }
         private void DisposeFrame(VideoFrame _frame)
         {
             if(m_DisposeBitmap != null)
@@ -351,11 +551,20 @@ namespace Kinovea.Video
             if(m_Frames.Count < 2 || !m_Segment.Wrapped)
                 return 0;
             
-            int i = 1;
-            while(m_Frames[i].Timestamp > m_Frames[i-1].Timestamp)
-                i++;
+            // The frames after the wrap are the ones before the first frame in time.
+            long first = m_Frames[0].Timestamp;
+            int low = 1;
+            int high = m_Frames.Count;
+            while(low < high)
+            {
+                int middle = low + ((high - low) / 2);
+                if(m_Frames[middle].Timestamp < first)
+                    high = middle;
+                else
+                    low = middle + 1;
+            }
             
-            return i;
+            return low;
         }
         private void ForgetOldFrames()
         {
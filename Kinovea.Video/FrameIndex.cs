@@ -0,0 +1,122 @@
+﻿#region License
+/*
+Copyright © Joan Charmant 2015.
+joan.charmant@gmail.com 
+ 
+This file is part of Kinovea.
+
+Kinovea is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 
+as published by the Free Software Foundation.
+
+Kinovea is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Kinovea. If not, see http://www.gnu.org/licenses/.
+*/
+#endregion
+using System;
+using System.Collections.Generic;
+
+namespace Kinovea.Video
+{
+    /// <summary>
+    /// The sorted presentation timestamps of a contiguous run of frames.
+    /// Frame number to timestamp is a direct lookup, timestamp to frame number is a binary search.
+    /// Unlike conversions based on the average frame duration, this is exact for variable frame rate files.
+    /// </summary>
+    public class FrameIndex
+    {
+        #region Properties
+        public int Count {
+            get { return m_Timestamps.Count; }
+        }
+        /// <summary>
+        /// Timestamp of the frame, counted from the first frame of the index.
+        /// </summary>
+        public long this[int _frame] {
+            get { return m_Timestamps[_frame]; }
+        }
+        public VideoSection Section {
+            get { return m_Timestamps.Count > 0 ? new VideoSection(m_Timestamps[0], m_Timestamps[m_Timestamps.Count - 1]) : VideoSection.Empty; }
+        }
+        #endregion
+        
+        #region Members
+        private List<long> m_Timestamps = new List<long>();
+        #endregion
+        
+        #region Public methods
+        /// <summary>
+        /// Insert a timestamp at its place. Frames are normally added in order so this is usually an append.
+        /// Duplicate timestamps are ignored.
+        /// </summary>
+        public void Add(long _timestamp)
+        {
+            int count = m_Timestamps.Count;
+            if(count == 0 || _timestamp > m_Timestamps[count - 1])
+            {
+                m_Timestamps.Add(_timestamp);
+                return;
+            }
+            
+            int index = m_Timestamps.BinarySearch(_timestamp);
+            if(index < 0)
+                m_Timestamps.Insert(~index, _timestamp);
+        }
+        
+        /// <summary>
+        /// Returns the number of the first frame at or after the timestamp, or -1 if the timestamp is after the last frame.
+        /// </summary>
+        public int GetFrame(long _timestamp)
+        {
+            int index = m_Timestamps.BinarySearch(_timestamp);
+            if(index < 0)
+                index = ~index;
+            
+            return index < m_Timestamps.Count ? index : -1;
+        }
+        
+        /// <summary>
+        /// Remove the timestamps outside the section.
+        /// </summary>
+        public void Reduce(VideoSection _section)
+        {
+            int end = GetFrame(_section.End + 1);
+            if(end >= 0)
+                m_Timestamps.RemoveRange(end, m_Timestamps.Count - end);
+            
+            int start = GetFrame(_section.Start);
+            m_Timestamps.RemoveRange(0, start >= 0 ? start : m_Timestamps.Count);
+        }
+        
+        public void Clear()
+        {
+            m_Timestamps.Clear();
+        }
+        
+        /// <summary>
+        /// Binary search in a range of frames sorted by timestamp.
+        /// Returns the index of the first frame at or after the timestamp, or _start + _count if there is none.
+        /// </summary>
+        public static int LowerBound(IList<VideoFrame> _frames, int _start, int _count, long _timestamp)
+        {
+            int low = _start;
+            int high = _start + _count;
+            while(low < high)
+            {
+                int middle = low + ((high - low) / 2);
+                if(_frames[middle].Timestamp < _timestamp)
+                    low = middle + 1;
+                else
+                    high = middle;
+            }
+            
+            return low;
+        }
+        #endregion
+    }
+}
@@ -39,14 +39,13 @@ namespace Kinovea.Video
     /// (Some advanced storage classes are provided: Cache, Prebuffer).
     /// 
     /// Images should be decoded in the Format32bppPArgb pixel format.
+    /// Readers of monochrome sources may decode in Format8bppIndexed with a gray palette instead, see DecodingPixelFormat.
     /// 
     /// Implementers: you may consider subclassing a more specific abstract class like VideoReaderAlwaysCaching,
     /// as they provide some boilerplate code for functions irrelevant to some video readers.
     /// </summary>
     public abstract class VideoReader
     {
-        public const PixelFormat DecodingPixelFormat = PixelFormat.Format32bppPArgb;
-        
         #region Properties
         public abstract VideoFrame Current { get; }
         public abstract VideoCapabilities Flags { get; }
@@ -55,12 +54,25 @@ namespace Kinovea.Video
         public abstract VideoSection WorkingZone { get;}
         public abstract VideoDecodingMode DecodingMode { get; }
         
+        /// <summary>
+        /// Pixel format of the decoded images.
+        /// </summary>
+        public virtual PixelFormat DecodingPixelFormat {
+            get { return PixelFormat.Format32bppPArgb; }
+        }
+        
         public virtual IWorkingZoneFramesContainer WorkingZoneFrames {
             get { return null;}
         }
         public virtual VideoSection PreBufferingSegment {
             get { return VideoSection.Empty; }
         }
+        /// <summary>
+        /// Exact timestamps of the frames of the working zone, if known. Null otherwise.
+        /// </summary>
+        public virtual FrameIndex FrameIndex {
+            get { return null; }
+        }
         // If the reader is subject to decoding drops (prebuffering), this property should be filled accordingly.
         public virtual int Drops {
             get {return 0; }
@@ -84,6 +96,29 @@ namespace Kinovea.Video
             get { return false;}
         }
         
+        /// <summary>
+        /// The part of the image the current frames cover, in aspect ratio size coordinates.
+        /// Empty if the frames cover the whole image.
+        /// </summary>
+        public virtual Rectangle DecodingRegion {
+            get { return Rectangle.Empty; }
+        }
+        
+        /// <summary>
+        /// Whether SeekAsync can be used in the current decoding mode.
+        /// </summary>
+        public virtual bool CanSeekAsync {
+            get { return false; }
+        }
+        
+        /// <summary>
+        /// Whether the reader is still measuring the framerate and duration in the background.
+        /// The info may then change, see VideoInfoRefined.
+        /// </summary>
+        public virtual bool RefiningVideoInfo {
+            get { return false; }
+        }
+        
         // Shorcuts for capabilities.
         public bool CanDecodeOnDemand {
             get { return (Flags & VideoCapabilities.CanDecodeOnDemand) != 0; }
@@ -110,6 +145,21 @@ namespace Kinovea.Video
         {
             get { return (Flags & VideoCapabilities.CanScaleIndefinitely) != 0; }
         }
+        public bool CanDecodeRegion {
+            get { return (Flags & VideoCapabilities.CanDecodeRegion) != 0; }
+        }
+        #endregion
+
+        #region Events
+        /// <summary>
+        /// Raised on the decoding thread when an asynchronous seek has decoded a frame.
+        /// </summary>
+        public event EventHandler<SeekCompletedEventArgs> SeekCompleted;
+        
+        /// <summary>
+        /// Raised on a background thread when the measure of the framerate and duration started at load time is over.
+        /// </summary>
+        public event EventHandler VideoInfoRefined;
         #endregion
 
         #region Members
@@ -154,7 +204,7 @@ namespace Kinovea.Video
         #region Move playhead
         public bool MovePrev()
         {
-            return MoveTo(Current.Timestamp - Info.AverageTimeStampsPerFrame);
+            return MoveTo(GetTimestampAfter(Current.Timestamp, -1));
         }
         public bool MoveFirst()
         {
@@ -173,12 +223,84 @@ namespace Kinovea.Video
             else
             {
                 long currentTimestamp = Current == null ? 0 : Current.Timestamp;
-                long target = currentTimestamp + (Info.AverageTimeStampsPerFrame * _frames);
+                long target = GetTimestampAfter(currentTimestamp, _frames);
                 if(target < 0)
                     target = 0;
                 return MoveTo(target);
             }
         }
+        private long GetTimestampAfter(long _timestamp, int _frames)
+        {
+            // Use the exact timestamps when available, otherwise assume a constant frame rate.
+            FrameIndex index = FrameIndex;
+            if(index != null)
+            {
+                int frame = index.GetFrame(_timestamp);
+                int target = frame + _frames;
+                if(frame >= 0 && index[frame] == _timestamp && target >= 0 && target < index.Count)
+                    return index[target];
+            }
+            
+            return _timestamp + (Info.AverageTimeStampsPerFrame * _frames);
+        }
+        #endregion
+        
+        #region Asynchronous seek
+        /// <summary>
+        /// Ask for an arbitrary frame without waiting for it, typically while the user drags the timeline.
+        /// <para>Newer requests supersede pending ones. The reader may first provide the closest keyframe,</para>
+        /// <para>and refine to the exact frame when no new request has come for a short while.</para>
+        /// <para>SeekCompleted is raised on the decoding thread when a frame is ready, the UI thread must then call ApplyAsyncSeek.</para>
+        /// </summary>
+        /// <returns>true if the frame was available right away and is already current. No event is raised in this case.</returns>
+        public virtual bool SeekAsync(long _timestamp)
+        {
+            throw new CapabilityNotSupportedException();
+        }
+        
+        /// <summary>
+        /// Make the last frame decoded by an asynchronous seek the current one. Must be called from the UI thread.
+        /// </summary>
+        /// <returns>false if there was no new frame.</returns>
+        public virtual bool ApplyAsyncSeek()
+        {
+            return false;
+        }
+        
+        /// <summary>
+        /// Stop the asynchronous seeks and wait for the decoding in progress.
+        /// The reader is then back to regular operations, the caller should move to the final position with MoveTo.
+        /// </summary>
+        public virtual void EndSeekAsync()
+        {
+            // Does nothing by default. Override to implement.
+        }
+        
+        protected void OnSeekCompleted(long _timestamp, bool _exact)
+        {
+            EventHandler<SeekCompletedEventArgs> handler = SeekCompleted;
+            if(handler != null)
+                handler(this, new SeekCompletedEventArgs(_timestamp, _exact));
+        }
+        #endregion
+        
+        #region Video info refinement
+        /// <summary>
+        /// Update the video info with the values measured in the background, once VideoInfoRefined has been raised.
+        /// Must be called from the UI thread. The working zone is extended or shrunk if it was the whole video.
+        /// </summary>
+        /// <returns>true if the video info changed.</returns>
+        public virtual bool ApplyVideoInfoRefinement()
+        {
+            return false;
+        }
+        
+        protected void OnVideoInfoRefined()
+        {
+            EventHandler handler = VideoInfoRefined;
+            if(handler != null)
+                handler(this, EventArgs.Empty);
+        }
         #endregion
         
         public virtual bool CanSwitchDecodingMode(VideoDecodingMode _mode)
@@ -243,6 +365,15 @@ namespace Kinovea.Video
         {
             // Does nothing by default. Override to implement.
         }
+        /// <summary>
+        /// Ask the reader to provide only a region of its images, in aspect ratio size coordinates, at a specific size.
+        /// Not necessarily honored by the reader, check DecodingRegion.
+        /// ChangeDecodingSize and DisableCustomDecodingSize go back to the whole image.
+        /// </summary>
+        public virtual void ChangeDecodingRegion(Rectangle _region, Size _size)
+        {
+            // Does nothing by default. Override to implement.
+        }
         
         /// <summary>
         /// Provide a lazy enumerator on each frame of the Working Zone.
@@ -42,6 +42,9 @@ namespace Kinovea.Video
         public override IWorkingZoneFramesContainer WorkingZoneFrames {
             get { return m_Cache;}
         }
+        public override FrameIndex FrameIndex {
+            get { return m_Cache.Index; }
+        }
         protected Cache Cache {
             get { return m_Cache;}
         }